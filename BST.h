@@ -12,19 +12,46 @@
 #define BST_H
 // BST class
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <locale>
+#include <memory>
+#include <new>
 #include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
 
-#include "LinkedList.h"
+#include "FrozenBST.h"
+#include "NodeAllocator.h"
+#include "Serialize.h"
+#include "ThreadPool.h"
+#include "TreeBalance.h"
 
 namespace simple {
+    //! Subtree size of node, used by order statistics.
+    struct NodeSubtreeSize {
+        size_t m_size{1};//!< Number of nodes in subtree of node, node included.
+    };
+
+    //! Empty base of node without order statistics.
+    struct NodeNoSubtreeSize {};
+
     //! Binary search tree node struct.
 
     //! Defines node of binary search tree with pointers to parent, left and right child.
-    template<typename T>
-    struct Node {
+    //! If Counted is true node also stores size of its subtree.
+    template<typename T, bool Counted = false>
+    struct Node : std::conditional_t<Counted, NodeSubtreeSize, NodeNoSubtreeSize> {
+        static constexpr bool counted = Counted;//!< True if node stores size of its subtree.
+
         //! Default constructor.
         Node() = default;
 
@@ -35,12 +62,8 @@ namespace simple {
         //! @param ptrParent Pointer to parent node.
         //! @param ptrLeft Pointer to left child.
         //! @param ptrRight Pointer to right child.
-        Node(const T &value, Node *ptrParent, Node *ptrLeft, Node *ptrRight) {
-            m_data = new T(value);
-            m_parent = ptrParent;
-            m_leftNode = ptrLeft;
-            m_rightNode = ptrRight;
-        }
+        Node(const T &value, Node *ptrParent, Node *ptrLeft, Node *ptrRight)
+            : m_data(value), m_parent(ptrParent), m_leftNode(ptrLeft), m_rightNode(ptrRight) {}
 
         //! Four argument constructor.
 
@@ -49,32 +72,49 @@ namespace simple {
         //! @param ptrParent Pointer to parent node.
         //! @param ptrLeft Pointer to left child.
         //! @param ptrRight Pointer to right child.
-        Node(T &&value, Node *ptrParent, Node *ptrLeft, Node *ptrRight) {
-            m_data = new T(std::move(value));
-            m_parent = ptrParent;
-            m_leftNode = ptrLeft;
-            m_rightNode = ptrRight;
+        Node(T &&value, Node *ptrParent, Node *ptrLeft, Node *ptrRight)
+            : m_data(std::move(value)), m_parent(ptrParent), m_leftNode(ptrLeft), m_rightNode(ptrRight) {}
+
+        //! In place constructor.
+
+        //! Constructs data directly inside the node from given arguments.
+        //! @param ptrParent Pointer to parent node.
+        //! @param ptrLeft Pointer to left child.
+        //! @param ptrRight Pointer to right child.
+        //! @param args Arguments forwarded to constructor of T.
+        template<typename... Args>
+        Node(std::in_place_t, Node *ptrParent, Node *ptrLeft, Node *ptrRight, Args &&...args)
+            : m_data(std::forward<Args>(args)...), m_parent(ptrParent), m_leftNode(ptrLeft), m_rightNode(ptrRight) {}
+
+        //! Returns size of subtree.
+
+        //! @param node Root of subtree, may be nullptr.
+        //! @return Number of nodes in subtree, always 0 if node does not store it.
+        static size_t sizeOf(const Node *node) {
+            if constexpr (Counted)
+                return node ? node->m_size : 0;
+            else
+                return 0;
         }
 
-        //! Destructor of node, deletes data.
-        ~Node() {
-            delete m_data;
-            m_parent = nullptr;
-            m_leftNode = nullptr;
-            m_rightNode = nullptr;
+        //! Recomputes size of subtree from children, called after children of node were changed.
+        void update() {
+            if constexpr (Counted) this->m_size = 1 + sizeOf(m_leftNode) + sizeOf(m_rightNode);
         }
 
-        T *m_data;        //!< Pointer to stored data.
-        Node *m_parent;   //!< Pointer to parent node.
-        Node *m_leftNode; //!< Pointer to left child.
-        Node *m_rightNode;//!< Pointer to right child.
+        T m_data;           //!< Stored data.
+        bool m_red{};       //!< Color of node, used by red-black balancing.
+        Node *m_parent{};   //!< Pointer to parent node.
+        Node *m_leftNode{}; //!< Pointer to left child.
+        Node *m_rightNode{};//!< Pointer to right child.
     };
 
     //! Binary search tree forward iterator class.
 
-    //! Iterator for binary search tree, it uses some container as "stack" to keep history of where it points.
+    //! Iterator for binary search tree, it keeps only pointer to current node and
+    //! moves to successor using parent pointers, so it never allocates and is trivially copyable.
     //! It is in order iterator, from min to max.
-    template<typename T>
+    template<typename T, typename NodeT = Node<T>>
     class BinarySearchTreeIterator {
     public:
         //! Default constructor for forward iterator.
@@ -82,60 +122,25 @@ namespace simple {
 
         //! One argument constructor.
 
-        //! Accepts pointer to root node of a tree, then initialize a stack.
-        //! @param ptrRoot Pointer to a root of tree.
-        explicit BinarySearchTreeIterator(Node<T> *ptrRoot) {
-            Node<T> *curr = ptrRoot;
-            while (curr) {
-                m_ptrsStack.pushBack(curr);
-                curr = curr->m_leftNode;
-            }
-        }
-
-        //! Copy constructor for forward iterator.
-        BinarySearchTreeIterator(const BinarySearchTreeIterator &other) {
-            m_ptrsStack = other.m_ptrsStack;
-        }
-
-        //! Move constructor for forward iterator.
-        BinarySearchTreeIterator(BinarySearchTreeIterator &&other) noexcept {
-            m_ptrsStack.clear();
-            m_ptrsStack = std::move(other.m_ptrsStack);
-        }
-
-        //! Move operator for forward iterator.
-
-        //! @param other Other iterator to copy from.
-        //! @return Iterator.
-        BinarySearchTreeIterator &operator=(BinarySearchTreeIterator &&other) noexcept {
-            if (this != &other) {
-                m_ptrsStack.clear();
-                m_ptrsStack = std::move(other.m_ptrsStack);
-            }
-            return *this;
-        }
-
-        //! Copy operator for forward iterator.
-
-        //! @param other Other iterator to move.
-        //! @return Iterator.
-        BinarySearchTreeIterator &operator=(const BinarySearchTreeIterator &other) {
-            if (this != &other) {
-                m_ptrsStack = other.m_ptrsStack;
-            }
-            return *this;
-        }
+        //! Accepts pointer to node iterator points at.
+        //! @param ptrNode Pointer to node, nullptr for end iterator.
+        explicit BinarySearchTreeIterator(const NodeT *ptrNode) : m_node(ptrNode) {}
 
         //! Pre-incrementation operator.
 
-        //! Increment iterator to next place.
+        //! Increment iterator to next place, amortized O(1).
         //! @return New iterator.
         BinarySearchTreeIterator &operator++() {
-            Node<T> *curr = m_ptrsStack.back()->m_rightNode;
-            m_ptrsStack.popBack();
-            while (curr) {
-                m_ptrsStack.pushBack(curr);
-                curr = curr->m_leftNode;
+            if (m_node->m_rightNode) {
+                m_node = m_node->m_rightNode;
+                while (m_node->m_leftNode) m_node = m_node->m_leftNode;
+            } else {
+                const NodeT *tmpParent = m_node->m_parent;
+                while (tmpParent && m_node == tmpParent->m_rightNode) {
+                    m_node = tmpParent;
+                    tmpParent = tmpParent->m_parent;
+                }
+                m_node = tmpParent;
             }
             return *this;
         }
@@ -152,12 +157,30 @@ namespace simple {
 
         //! Incrementation operator.
 
-        //! Increment iterator n times.
+        //! Increment iterator n times. If nodes store sizes of subtrees it takes O(h),
+        //! whole subtrees are skipped, otherwise iterator is incremented one step at a time.
         //! @return New iterator.
         BinarySearchTreeIterator &operator+(size_t i) {
-            while (i) {
-                (*this)++;
-                i--;
+            if constexpr (NodeT::counted) {
+                while (i && m_node) {
+                    size_t rightSize = NodeT::sizeOf(m_node->m_rightNode);
+                    if (i <= rightSize) {
+                        m_node = select(m_node->m_rightNode, i - 1);
+                        return *this;
+                    }
+                    i -= rightSize + 1;
+                    const NodeT *tmpParent = m_node->m_parent;
+                    while (tmpParent && m_node == tmpParent->m_rightNode) {
+                        m_node = tmpParent;
+                        tmpParent = tmpParent->m_parent;
+                    }
+                    m_node = tmpParent;
+                }
+            } else {
+                while (i) {
+                    ++(*this);
+                    i--;
+                }
             }
             return *this;
         }
@@ -165,19 +188,19 @@ namespace simple {
         //! Dereference operator.
 
         //! @return Value of T.
-        const T &operator*() const { return *m_ptrsStack.back()->m_data; }
+        const T &operator*() const { return m_node->m_data; }
 
         //! Pointer operator.
 
         //! @return Pointer to T.
-        const T *operator->() const { return m_ptrsStack.back()->m_data; }
+        const T *operator->() const { return &m_node->m_data; }
 
         //! Compare operator.
 
         //! @param other Iterator to compare with.
         //! @return True if iterators are the same, false otherwise.
         bool operator==(const BinarySearchTreeIterator &other) const {
-            return m_ptrsStack.ptrBack() == other.m_ptrsStack.ptrBack();
+            return m_node == other.m_node;
         }
 
         //! Difference operator.
@@ -185,21 +208,38 @@ namespace simple {
         //! @param other Iterator to compare with.
         //! @return True if iterators are different, false otherwise.
         bool operator!=(const BinarySearchTreeIterator &other) const {
-            return m_ptrsStack.ptrBack() != other.m_ptrsStack.ptrBack();
+            return m_node != other.m_node;
         }
 
     private:
-        LinkedList<Node<T> *>
-                m_ptrsStack;//!< LinkedList used as stack, needed in iterator.
-        //It was forward list written by me, after making
-        // it bidirectional, I used it as "stack"
+        //! Select function.
+
+        //! @param root Local root.
+        //! @param index Index of node in order in subtree, less than size of subtree.
+        //! @return Node at given index.
+        static const NodeT *select(const NodeT *root, size_t index) {
+            while (true) {
+                size_t leftSize = NodeT::sizeOf(root->m_leftNode);
+                if (index < leftSize) {
+                    root = root->m_leftNode;
+                } else if (index == leftSize) {
+                    return root;
+                } else {
+                    index -= leftSize + 1;
+                    root = root->m_rightNode;
+                }
+            }
+        }
+
+        const NodeT *m_node{};//!< Pointer to node iterator points at, nullptr at the end.
     };
 
     //! Binary search tree reverse iterator class.
 
-    //! Iterator for binary search tree, it uses some container as "stack" to keep history where it points.
+    //! Iterator for binary search tree, it keeps only pointer to current node and
+    //! moves to predecessor using parent pointers, so it never allocates and is trivially copyable.
     //! It is in order iterator, from max to min.
-    template<typename T>
+    template<typename T, typename NodeT = Node<T>>
     class BinarySearchTreeReverseIterator {
     public:
         //! Default constructor for reverse iterator.
@@ -207,60 +247,25 @@ namespace simple {
 
         //! One argument constructor.
 
-        //! Accepts pointer to root node of a tree, then initialize a stack.
-        //! @param ptrRoot Pointer to a root of tree.
-        explicit BinarySearchTreeReverseIterator(Node<T> *ptrRoot) {
-            Node<T> *curr = ptrRoot;
-            while (curr) {
-                m_ptrsStack.pushBack(curr);
-                curr = curr->m_rightNode;
-            }
-        }
-
-        //! Copy constructor for reverse iterator.
-        BinarySearchTreeReverseIterator(const BinarySearchTreeReverseIterator &other) {
-            m_ptrsStack = other.m_ptrsStack;
-        }
-
-        //! Move constructor for reverse iterator.
-        BinarySearchTreeReverseIterator(BinarySearchTreeReverseIterator &&other) noexcept {
-            m_ptrsStack.clear();
-            m_ptrsStack = std::move(other.m_ptrsStack);
-        }
-
-        //! Move operator for reverse iterator.
-
-        //! @param other Other iterator to copy from.
-        //! @return Iterator.
-        BinarySearchTreeReverseIterator &operator=(BinarySearchTreeReverseIterator &&other) noexcept {
-            if (this != &other) {
-                m_ptrsStack.clear();
-                m_ptrsStack = std::move(other.m_ptrsStack);
-            }
-            return *this;
-        }
-
-        //! Copy operator for reverse iterator.
-
-        //! @param other Other iterator to move.
-        //! @return Iterator.
-        BinarySearchTreeReverseIterator &operator=(const BinarySearchTreeReverseIterator &other) {
-            if (this != &other) {
-                m_ptrsStack = other.m_ptrsStack;
-            }
-            return *this;
-        }
+        //! Accepts pointer to node iterator points at.
+        //! @param ptrNode Pointer to node, nullptr for end iterator.
+        explicit BinarySearchTreeReverseIterator(const NodeT *ptrNode) : m_node(ptrNode) {}
 
         //! Pre-incrementation operator.
 
-        //! Increment iterator to next place.
+        //! Increment iterator to next place, amortized O(1).
         //! @return New iterator.
         BinarySearchTreeReverseIterator &operator++() {
-            Node<T> *curr = m_ptrsStack.back()->m_leftNode;
-            m_ptrsStack.popBack();
-            while (curr) {
-                m_ptrsStack.pushBack(curr);
-                curr = curr->m_rightNode;
+            if (m_node->m_leftNode) {
+                m_node = m_node->m_leftNode;
+                while (m_node->m_rightNode) m_node = m_node->m_rightNode;
+            } else {
+                const NodeT *tmpParent = m_node->m_parent;
+                while (tmpParent && m_node == tmpParent->m_leftNode) {
+                    m_node = tmpParent;
+                    tmpParent = tmpParent->m_parent;
+                }
+                m_node = tmpParent;
             }
             return *this;
         }
@@ -281,7 +286,7 @@ namespace simple {
         //! @return New iterator.
         BinarySearchTreeReverseIterator &operator+(size_t i) {
             while (i) {
-                (*this)++;
+                ++(*this);
                 i--;
             }
             return *this;
@@ -290,19 +295,19 @@ namespace simple {
         //! Dereference operator.
 
         //! @return Value of T.
-        const T &operator*() const { return *m_ptrsStack.back()->m_data; }
+        const T &operator*() const { return m_node->m_data; }
 
         //! Pointer operator.
 
         //! @return Pointer to T.
-        const T *operator->() const { return m_ptrsStack.back()->m_data; }
+        const T *operator->() const { return &m_node->m_data; }
 
         //! Compare operator.
 
         //! @param other Iterator to compare with.
         //! @return True if iterators are the same, false otherwise.
         bool operator==(const BinarySearchTreeReverseIterator &other) const {
-            return m_ptrsStack.ptrBack() == other.m_ptrsStack.ptrBack();
+            return m_node == other.m_node;
         }
 
         //! Difference operator.
@@ -310,80 +315,367 @@ namespace simple {
         //! @param other Iterator to compare with.
         //! @return True if iterators are different, false otherwise.
         bool operator!=(const BinarySearchTreeReverseIterator &other) const {
-            return m_ptrsStack.ptrBack() != other.m_ptrsStack.ptrBack();
+            return m_node != other.m_node;
         }
 
     private:
-        LinkedList<Node<T> *>
-                m_ptrsStack;//!< LinkedList used as stack, needed in iterator.
-        // It was forward list written by me, after making
-        // it bidirectional, I used it as "stack"
+        const NodeT *m_node{};//!< Pointer to node iterator points at, nullptr at the end.
+    };
+
+    //! Range of binary search tree.
+
+    //! Pair of iterators which can be used in range based for loop.
+    template<typename Iterator>
+    class BinarySearchTreeRange {
+    public:
+        //! Two argument constructor.
+
+        //! @param first Iterator to first element of range.
+        //! @param last Iterator past last element of range.
+        BinarySearchTreeRange(Iterator first, Iterator last) : m_first(first), m_last(last) {}
+
+        //! Iterator to first element of range.
+
+        //! @return begin iterator.
+        Iterator begin() const { return m_first; }
+
+        //! Iterator past last element of range.
+
+        //! @return end iterator.
+        Iterator end() const { return m_last; }
+
+        //! True if range is empty.
+
+        //! @return True if range is empty.
+        [[nodiscard]] bool empty() const { return m_first == m_last; }
+
+    private:
+        Iterator m_first;//!< Iterator to first element of range.
+        Iterator m_last; //!< Iterator past last element of range.
+    };
+
+    //! Storage for comparison criteria.
+
+    //! Empty comparators (like std::less) are stored as base class, so they take no space
+    //! and calls to them can be inlined.
+    template<typename Compare, bool = std::is_empty_v<Compare> && !std::is_final_v<Compare>>
+    class CompareStorage : private Compare {
+    public:
+        //! Constructor.
+
+        //! @param comp Comparison criteria.
+        explicit CompareStorage(const Compare &comp) : Compare(comp) {}
+
+        //! Returns comparison criteria.
+
+        //! @return Reference to comparator.
+        const Compare &comparator() const { return *this; }
+    };
+
+    //! Storage for comparison criteria which cannot be base class (function pointers, non empty objects).
+    template<typename Compare>
+    class CompareStorage<Compare, false> {
+    public:
+        //! Constructor.
+
+        //! @param comp Comparison criteria.
+        explicit CompareStorage(const Compare &comp) : m_comp(comp) {}
+
+        //! Returns comparison criteria.
+
+        //! @return Reference to comparator.
+        const Compare &comparator() const { return m_comp; }
+
+    private:
+        Compare m_comp;//!< Comparison criteria.
+    };
+
+    //! Stream buffer passing written data to callback.
+
+    //! Data is collected in buffer and handed to writer when buffer is full or stream is flushed,
+    //! writes larger than buffer go to writer directly.
+    template<typename Writer>
+    class CallbackOutputBuffer : public std::streambuf {
+    public:
+        //! Constructor.
+
+        //! @param write Function called with pointer to data and its size.
+        explicit CallbackOutputBuffer(Writer &write) : m_write(write), m_buffer(new char[bufferSize]) {
+            setp(m_buffer.get(), m_buffer.get() + bufferSize);
+        }
+
+    protected:
+        //! Hands buffer to writer and stores character in empty buffer.
+
+        //! @param ch Character which did not fit.
+        //! @return Character or eof on error.
+        int_type overflow(int_type ch) override {
+            if (sync()) return traits_type::eof();
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        //! Hands buffered data to writer.
+
+        //! @return 0, writer reports errors by exception.
+        int sync() override {
+            if (pptr() != pbase()) m_write(static_cast<const char *>(pbase()), static_cast<size_t>(pptr() - pbase()));
+            setp(m_buffer.get(), m_buffer.get() + bufferSize);
+            return 0;
+        }
+
+        //! Writes block of data, blocks which do not fit go to writer without copying.
+
+        //! @param data Pointer to data.
+        //! @param count Size of data.
+        //! @return Number of written characters.
+        std::streamsize xsputn(const char *data, std::streamsize count) override {
+            if (count <= epptr() - pptr()) {
+                std::memcpy(pptr(), data, static_cast<size_t>(count));
+                pbump(static_cast<int>(count));
+            } else {
+                sync();
+                m_write(data, static_cast<size_t>(count));
+            }
+            return count;
+        }
+
+    private:
+        static constexpr size_t bufferSize = size_t(1) << 18;//!< Size of buffer.
+
+        Writer &m_write;                //!< Function receiving data.
+        std::unique_ptr<char[]> m_buffer;//!< Buffer of written data.
+    };
+
+    //! Stream buffer taking read data from callback.
+
+    //! Buffer is refilled by reader when it runs empty, reads larger than buffer go to destination directly.
+    //! Reader returning 0 ends stream.
+    template<typename Reader>
+    class CallbackInputBuffer : public std::streambuf {
+    public:
+        //! Constructor.
+
+        //! @param read Function called with pointer to buffer and its size, returns number of bytes read.
+        explicit CallbackInputBuffer(Reader &read) : m_read(read), m_buffer(new char[bufferSize]) {
+            setg(m_buffer.get(), m_buffer.get(), m_buffer.get());
+        }
+
+    protected:
+        //! Refills buffer from reader.
+
+        //! @return Next character or eof at end.
+        int_type underflow() override {
+            if (gptr() == egptr()) {
+                const size_t read = m_read(m_buffer.get(), bufferSize);
+                setg(m_buffer.get(), m_buffer.get(), m_buffer.get() + std::min(read, bufferSize));
+                if (!read) return traits_type::eof();
+            }
+            return traits_type::to_int_type(*gptr());
+        }
+
+        //! Reads block of data, buffered data is copied first, rest is read to destination without copying.
+
+        //! @param data Destination.
+        //! @param count Size of data.
+        //! @return Number of read characters.
+        std::streamsize xsgetn(char *data, std::streamsize count) override {
+            std::streamsize done = std::min<std::streamsize>(count, egptr() - gptr());
+            std::memcpy(data, gptr(), static_cast<size_t>(done));
+            gbump(static_cast<int>(done));
+            while (done < count) {
+                if (count - done < static_cast<std::streamsize>(bufferSize)) {
+                    if (traits_type::eq_int_type(underflow(), traits_type::eof())) break;
+                    const std::streamsize part = std::min<std::streamsize>(count - done, egptr() - gptr());
+                    std::memcpy(data + done, gptr(), static_cast<size_t>(part));
+                    gbump(static_cast<int>(part));
+                    done += part;
+                } else {
+                    const size_t read = m_read(data + done, static_cast<size_t>(count - done));
+                    if (!read) break;
+                    done += static_cast<std::streamsize>(read);
+                }
+            }
+            return done;
+        }
+
+    private:
+        static constexpr size_t bufferSize = size_t(1) << 18;//!< Size of buffer.
+
+        Reader &m_read;                 //!< Function providing data.
+        std::unique_ptr<char[]> m_buffer;//!< Buffer of read data.
     };
 
     //! Binary search tree class.
 
     //! Stores pointer to root and number of nodes.
-    template<typename T>
-    class BinarySearchTree {
+    //! Elements are ordered by Compare, two elements are equal if neither is less than the other.
+    //! Shape of tree is kept by Balance policy, Unbalanced by default or RedBlack.
+    //! Nodes are obtained from NodeAllocator policy, HeapNodeAllocator by default
+    //! or SlabNodeAllocator which hands out nodes from contiguous chunks.
+    //! If OrderStatistics is true nodes store sizes of their subtrees, which gives
+    //! nth(), rank() and iterator + k in O(h).
+    template<typename T, typename Compare = std::less<T>, typename Balance = Unbalanced, template<typename> class NodeAllocator = HeapNodeAllocator, bool OrderStatistics = false>
+    class BinarySearchTree : private CompareStorage<Compare> {
     private:
-        typedef Node<T> m_Node;
+        typedef CompareStorage<Compare> m_CompareStorage;
+        typedef Node<T, OrderStatistics> m_Node;
+        typedef NodeAllocator<m_Node> m_Allocator;
+
+        //! Map walks down by keys and links its nodes itself ([MapBST.h](MapBST.h)).
+        template<typename, typename, typename, typename, template<typename> class>
+        friend class BinarySearchMap;
 
     public:
-        typedef BinarySearchTreeIterator<T> iterator;
-        typedef BinarySearchTreeReverseIterator<T> reverse_iterator;
+        typedef BinarySearchTreeIterator<T, m_Node> iterator;
+        typedef BinarySearchTreeReverseIterator<T, m_Node> reverse_iterator;
+        typedef BinarySearchTreeRange<iterator> range_type;
+        typedef Compare compare_type;
+        typedef m_Allocator allocator_type;
+
+        //! Node handle.
+
+        //! Owns node extracted from binary search tree, together with allocator which can free it.
+        //! Node can be inserted to any tree whose allocator shares memory with it, without copying data.
+        class node_type {
+        public:
+            //! Default constructor, creates empty handle.
+            node_type() = default;
+
+            //! Copy constructor, deleted.
+            node_type(const node_type &other) = delete;
+
+            //! Move constructor.
+
+            //! @param other Node handle to move, it is empty afterwards.
+            node_type(node_type &&other) noexcept : m_node(other.m_node), m_allocator(std::move(other.m_allocator)) {
+                other.m_node = nullptr;
+            }
+
+            //! Copy operator, deleted.
+            node_type &operator=(const node_type &other) = delete;
+
+            //! Move operator.
+
+            //! Destroys owned node and takes node of other handle.
+            //! @param other Node handle to move, it is empty afterwards.
+            //! @return Node handle.
+            node_type &operator=(node_type &&other) noexcept {
+                if (this != &other) {
+                    reset();
+                    m_node = other.m_node;
+                    m_allocator = std::move(other.m_allocator);
+                    other.m_node = nullptr;
+                }
+                return *this;
+            }
+
+            //! Destructor, destroys owned node.
+            ~node_type() { reset(); }
+
+            //! Checks if handle is empty.
+
+            //! @return True if handle does not own node.
+            [[nodiscard]] bool empty() const { return !m_node; }
+
+            //! Checks if handle owns node.
+
+            //! @return True if handle owns node.
+            explicit operator bool() const { return m_node; }
+
+            //! Returns data of owned node.
+
+            //! Data may be modified, node is not in any tree.
+            //! @return Reference to data.
+            T &value() const { return m_node->m_data; }
+
+        private:
+            friend class BinarySearchTree;
+
+            //! Constructor used by extract().
+
+            //! @param node Detached node.
+            //! @param allocator Allocator sharing memory with node.
+            node_type(m_Node *node, m_Allocator &&allocator) : m_node(node), m_allocator(std::move(allocator)) {}
+
+            //! Destroys owned node.
+            void reset() {
+                if (!m_node) return;
+                m_node->~m_Node();
+                m_allocator.deallocate(m_node);
+                m_node = nullptr;
+            }
+
+            m_Node *m_node{};        //!< Owned node.
+            m_Allocator m_allocator;//!< Allocator which can free node.
+        };
+
+        //! Result of inserting node handle.
+        struct insert_return_type {
+            iterator position;//!< Inserted element, or equal element already in tree.
+            bool inserted;    //!< True if node was inserted.
+            node_type node;   //!< Node which was not inserted, empty otherwise.
+        };
 
     public:
         //! Default constructor.
 
-        //! @param compFunc Comparison function.
-        explicit BinarySearchTree(std::function<bool(const T &a, const T &b)> compFunc = [](const T &a, const T &b) { return a < b; }) : m_compFunc(compFunc){};
+        //! @param comp Comparison criteria.
+        explicit BinarySearchTree(const Compare &comp = Compare()) : m_CompareStorage(comp){};
 
         //! Copy constructor.
 
+        //! Copies shape of other tree node by node in one linear pass, no comparisons are made.
         //! @param other Binary search tree to copy.
-        BinarySearchTree(const BinarySearchTree &other) {
-            simple::LinkedList<T> res;
-            save(other.m_rootNode, res);
-            for (auto &e: res)
-                insert(e);
-
-            m_compFunc = other.m_compFunc;
+        BinarySearchTree(const BinarySearchTree &other) : m_CompareStorage(other) {
+            m_allocator.reserve(other.m_numOfElements);
+            m_rootNode = clone(other.m_rootNode);
+            m_numOfElements = other.m_numOfElements;
         }
 
         //! Move constructor.
 
         //! @param other Binary search tree to move.
-        BinarySearchTree(BinarySearchTree &&other) noexcept {
+        BinarySearchTree(BinarySearchTree &&other) noexcept : m_CompareStorage(other), m_allocator(std::move(other.m_allocator)) {
             m_rootNode = other.m_rootNode;
             m_numOfElements = other.m_numOfElements;
-            m_compFunc = std::move(other.m_compFunc);
             other.m_rootNode = {};
             other.m_numOfElements = {};
-            other.m_compFunc = {};
         }
 
+        //! Allocator constructor.
+
+        //! Use allocator obtained from get_allocator() of other tree, so nodes can be moved
+        //! between both trees without copying (see merge(), insert(node_type &&) and split()).
+        //! @param comp Comparison criteria.
+        //! @param allocator Allocator of nodes.
+        BinarySearchTree(const Compare &comp, allocator_type &&allocator) : m_CompareStorage(comp), m_allocator(std::move(allocator)) {}
+
         //! Initializer list constructor.
 
         //! @param init Initializer list.
-        //! @param compFunc Comparison function.
-        BinarySearchTree(
-                std::initializer_list<T> init, std::function<bool(const T &a, const T &b)> compFunc = [](const T &a, const T &b) { return a < b; }) : m_compFunc(compFunc) {
-            for (auto &e: init)
-                insert(e);
+        //! @param comp Comparison criteria.
+        BinarySearchTree(std::initializer_list<T> init, const Compare &comp = Compare()) : m_CompareStorage(comp) {
+            build(init.begin(), init.end());
         }
 
         //! Copy operator.
 
+        //! Replaces content with copy of other tree, copies its shape in one linear pass.
+        //! Copy is built in new memory of a copy of own allocator and then moved in, because clear()
+        //! may free all memory of the allocator at once. If copying throws, tree is not changed.
         //! @param other Binary search tree to copy.
         //! @return Binary search tree.
         BinarySearchTree &operator=(const BinarySearchTree &other) {
-            if (this != &other && other.m_rootNode) {
-                LinkedList<T> res;
-                save(other.m_rootNode, res);
-                for (auto &e: res)
-                    insert(e);
-
-                m_compFunc = other.m_compFunc;
+            if (this != &other) {
+                BinarySearchTree tmp(other.comparator(), allocator_type(m_allocator));
+                tmp.m_allocator.reserve(other.m_numOfElements);
+                tmp.m_rootNode = tmp.clone(other.m_rootNode);
+                tmp.m_numOfElements = other.m_numOfElements;
+                *this = std::move(tmp);
             }
             return *this;
         }
@@ -394,69 +686,207 @@ namespace simple {
         //! @return Binary search tree.
         BinarySearchTree &operator=(BinarySearchTree &&other) noexcept {
             if (this != &other) {
+                clear();
+                m_allocator = std::move(other.m_allocator);
                 m_rootNode = other.m_rootNode;
                 m_numOfElements = other.m_numOfElements;
-                m_compFunc = std::move(other.m_compFunc);
+                m_CompareStorage::operator=(other);
                 other.m_rootNode = {};
                 other.m_numOfElements = {};
-                other.m_compFunc = {};
             }
             return *this;
         }
 
         //! Serialize function.
 
-        //! Writes binary search tree in binary format to file.
+        //! Writes binary search tree in binary format to file, see serialize(std::ostream &).
         //! @param fileName Name of file to save data to.
-        void serialize(const std::string &fileName) {
-            std::ofstream oFile(fileName, std::ios::out | std::ios::binary);
+        void serialize(const std::string &fileName) const {
+            std::unique_ptr<char[]> buffer(new char[streamBuffer]);
+            std::ofstream oFile;
+            oFile.rdbuf()->pubsetbuf(buffer.get(), streamBuffer);
+            oFile.open(fileName, std::ios::out | std::ios::binary);
             if (oFile && m_numOfElements) {
-                std::string data;
-                oFile.write(reinterpret_cast<char *>(&m_numOfElements), sizeof(m_numOfElements));
-                LinkedList<T> res;
-                save(m_rootNode, res);
-                for (auto &e: res) {
-                    std::stringstream ss;
-                    ss << e;
-                    data = ss.str();
-                    size_t strSize = data.size();
-                    oFile.write(reinterpret_cast<char *>(&strSize), sizeof(strSize));
-                    oFile.write(reinterpret_cast<char *>(data.data()), sizeof(char) * strSize);
-                }
+                serialize(oFile);
                 oFile.close();
             }
         }
 
+        //! Serialize function.
+
+        //! Writes binary search tree in binary format to stream, elements go in sorted order, one by one.
+        //! Integral elements are written as packed blocks of differences between neighbours, see simple::writePacked().
+        //! Other trivially copyable elements are written as raw block after header, in native byte order.
+        //! Other elements are written as length prefixed strings, std::string directly, other types formatted by << operator.
+        //! @param os Output stream opened in binary mode.
+        void serialize(std::ostream &os) const {
+            writeSorted<T>(os, iterator(m_rootNode ? min(m_rootNode) : nullptr), m_numOfElements);
+        }
+
+        //! Serialize function.
+
+        //! Writes binary search tree in binary format, see serialize(std::ostream &), to callback in chunks of buffer size.
+        //! @param write Function called with pointer to data and its size, it can throw to stop writing.
+        template<typename Writer, typename = std::enable_if_t<std::is_invocable_v<Writer &, const char *, size_t>>>
+        void serialize(Writer write) const {
+            CallbackOutputBuffer<Writer> buffer(write);
+            std::ostream os(&buffer);
+            os.exceptions(std::ios::badbit);
+            serialize(os);
+            os.flush();
+        }
+
         //! Deserialize function.
 
-        //! Reads binary data from file and fills binary search tree.
+        //! Reads binary data from file and fills binary search tree, see deserialize(std::istream &).
         //! @param fileName Name of file to read from.
         void deserialize(const std::string &fileName) {
-            std::ifstream iFile(fileName, std::ios::in | std::ios::binary);
+            std::unique_ptr<char[]> buffer(new char[streamBuffer]);
+            std::ifstream iFile;
+            iFile.rdbuf()->pubsetbuf(buffer.get(), streamBuffer);
+            iFile.open(fileName, std::ios::in | std::ios::binary);
             if (iFile) {
-                size_t tmpNumOfElements;
-                iFile.read(reinterpret_cast<char *>(&tmpNumOfElements), sizeof(tmpNumOfElements));
-                for (size_t i = 0; i < tmpNumOfElements; ++i) {
-                    std::stringstream ss;
-                    T tmp;
-                    size_t strSize;
-                    std::string data;
-                    iFile.read(reinterpret_cast<char *>(&strSize), sizeof(strSize));
-                    for(size_t j=0; j< strSize; ++j) data += iFile.get();
-                    ss << data;
-                    ss >> tmp;
-                    insert(tmp);
-                }
+                deserialize(iFile);
                 iFile.close();
             }
         }
 
+        //! Deserialize function.
+
+        //! Reads binary data from stream and fills binary search tree, all formats written by serialize() are accepted.
+        //! Elements are read in chunks of bounded size, sorted elements are linked in O(n).
+        //! @param is Input stream opened in binary mode.
+        void deserialize(std::istream &is) {
+            uint64_t header{};
+            if (!is.read(reinterpret_cast<char *>(&header), sizeof(header))) return;
+            if (header == packedMagic) {
+                if constexpr (packedElement<T>) readPacked(is);
+            } else if (header == rawMagic) {
+                if constexpr (std::is_trivially_copyable_v<T>) readRaw(is);
+            } else {
+                readStrings(is, static_cast<size_t>(header));
+            }
+        }
+
+        //! Deserialize function.
+
+        //! Reads binary data, see deserialize(std::istream &), from callback in chunks of buffer size.
+        //! @param read Function called with pointer to buffer and its size, returns number of bytes read, 0 at end.
+        template<typename Reader, typename = std::enable_if_t<std::is_invocable_r_v<size_t, Reader &, char *, size_t>>>
+        void deserialize(Reader read) {
+            CallbackInputBuffer<Reader> buffer(read);
+            std::istream is(&buffer);
+            deserialize(is);
+        }
+
+        //! Writes binary search tree as frozen tree file.
+
+        //! File can be mapped by FrozenBinarySearchTree and queried in place, without loading.
+        //! Available for trivially copyable types and std::string.
+        //! @param fileName Name of file to save data to.
+        //! @return True if file was written.
+        bool freeze_to(const std::string &fileName) const {
+            return writeFrozen<T>(fileName, iterator(m_rootNode ? min(m_rootNode) : nullptr), m_numOfElements);
+        }
+
+        //! Builds binary search tree from sorted range in O(n).
+
+        //! Replaces content of tree with elements of range. Range has to be sorted by comparison
+        //! criteria without equal elements, no comparisons are made. Tree is perfectly balanced.
+        //! @param first Iterator to first element.
+        //! @param last Iterator past last element.
+        template<typename InputIt>
+        void assign_sorted(InputIt first, InputIt last) {
+            clear();
+            NodeArray nodes;
+            if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+                nodes.reserve(static_cast<size_t>(std::distance(first, last)));
+                m_allocator.reserve(static_cast<size_t>(std::distance(first, last)));
+            }
+            try {
+                for (; first != last; ++first)
+                    nodes.push(createNode(*first, nullptr, nullptr, nullptr));
+            } catch (...) {
+                for (size_t i = 0; i < nodes.size(); ++i) destroyNode(nodes[i]);
+                throw;
+            }
+            link(nodes.data(), nodes.size());
+        }
+
+        //! Creates binary search tree from sorted range in O(n).
+
+        //! Range has to be sorted by comparison criteria without equal elements.
+        //! @param first Iterator to first element.
+        //! @param last Iterator past last element.
+        //! @param comp Comparison criteria.
+        //! @return Perfectly balanced binary search tree.
+        template<typename InputIt>
+        static BinarySearchTree from_sorted(InputIt first, InputIt last, const Compare &comp = Compare()) {
+            BinarySearchTree res(comp);
+            res.assign_sorted(first, last);
+            return res;
+        }
+
+        //! Builds binary search tree from any range.
+
+        //! Replaces content of tree with elements of range. Elements are sorted and from equal
+        //! elements only first one is kept, then tree is built in O(n) and is perfectly balanced.
+        //! Sorting is skipped for ranges which are already sorted, in any direction.
+        //! @param first Iterator to first element.
+        //! @param last Iterator past last element.
+        template<typename InputIt>
+        void build(InputIt first, InputIt last) {
+            clear();
+            size_t count{};
+            if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>)
+                count = static_cast<size_t>(std::distance(first, last));
+            bulkInsert(count, [&](NodeArray &nodes) {
+                for (; first != last; ++first)
+                    nodes.push(createNode(*first, nullptr, nullptr, nullptr));
+            });
+        }
+
+        //! Builds binary search tree from any range in parallel.
+
+        //! Works like build(first, last), but sorting and linking are split between threads of pool.
+        //! Nodes are created in parallel too if range is random access and allocator is thread safe.
+        //! Parts smaller than grain are processed sequentially.
+        //! @param first Iterator to first element.
+        //! @param last Iterator past last element.
+        //! @param pool Thread pool.
+        //! @param grain Minimal number of elements processed by one task.
+        template<typename InputIt>
+        void build(InputIt first, InputIt last, ThreadPool &pool, size_t grain = ThreadPool::defaultGrain) {
+            clear(pool, grain);
+            Parallel par{pool, grain};
+            pool.run([&] {
+                if constexpr (m_Allocator::threadSafe &&
+                              std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+                    const auto count = static_cast<size_t>(last - first);
+                    bulkInsert(count, [&](NodeArray &nodes) {
+                        nodes.resize(count);
+                        parallelFor(0, count, &par, [&](size_t i) {
+                            nodes.data()[i] = createNode(first[static_cast<std::ptrdiff_t>(i)], nullptr, nullptr, nullptr);
+                        });
+                    }, &par);
+                } else {
+                    size_t count{};
+                    if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>)
+                        count = static_cast<size_t>(std::distance(first, last));
+                    bulkInsert(count, [&](NodeArray &nodes) {
+                        for (; first != last; ++first)
+                            nodes.push(createNode(*first, nullptr, nullptr, nullptr));
+                    }, &par);
+                }
+            });
+        }
+
         //! Inserts data to binary search tree.
 
         //! @param data Data.
         //! @return Reference to data.
         const T &insert(const T &data) {
-            return *(insert(&m_rootNode, m_rootNode, data)->m_data);
+            return insertValue(data)->m_data;
         }
 
         //! Inserts data to binary search tree. (moves)
@@ -464,16 +894,25 @@ namespace simple {
         //! @param data Data.
         //! @return Reference to data.
         const T &insert(T &&data) {
-            return *(insert(&m_rootNode, m_rootNode, std::move(data))->m_data);
+            return insertValue(std::move(data))->m_data;
         }
 
-        //! Emplace data to binary search tree. (moves)
+        //! Emplace data to binary search tree.
 
+        //! Constructs data directly in a new node, node is discarded if equal data already exists.
         //! @param args argumets.
         //! @return Reference to emplaced object.
         template<typename... Args>
         const T &emplace(Args &&...args) {
-            return insert(T(std::forward<Args>(args)...));
+            auto node = createNode(std::in_place, nullptr, nullptr, nullptr, std::forward<Args>(args)...);
+            m_Node *parent;
+            m_Node **link = findLink(node->m_data, parent);
+            if (*link) {
+                destroyNode(node);
+                return (*link)->m_data;
+            }
+            attach(link, parent, node);
+            return node->m_data;
         }
 
         //! Removes data from binary search tree.
@@ -483,24 +922,48 @@ namespace simple {
 
         //! Clears binary search tree.
         void clear() {
-            clear(m_rootNode);
+            bool released = false;
+            if constexpr (m_Allocator::releasesAll && std::is_trivially_destructible_v<T>)
+                released = m_allocator.release();
+            if (!released) clear(m_rootNode);
             m_numOfElements = 0;
             m_rootNode = nullptr;
         }
 
+        //! Clears binary search tree in parallel.
+
+        //! Subtrees are destroyed by threads of pool, if allocator is not thread safe clear() is used.
+        //! @param pool Thread pool.
+        //! @param grain Minimal number of elements destroyed by one task.
+        void clear(ThreadPool &pool, size_t grain = ThreadPool::defaultGrain) {
+            if constexpr (m_Allocator::threadSafe) {
+                Parallel par{pool, grain};
+                pool.run([&] { clear(m_rootNode, &par, m_numOfElements); });
+                m_numOfElements = 0;
+                m_rootNode = nullptr;
+            } else {
+                clear();
+            }
+        }
+
         //! Search for data.
 
         //! @param data Data to search for.
         //! @return Pointer to found object.
         const T *search(const T &data) const {
             auto tmp = search(m_rootNode, data);
-            return tmp ? tmp->m_data : nullptr;
+            return tmp ? &tmp->m_data : nullptr;
         }
 
         //! Returns reference to root object.
 
         //! @return Reference to root object.
-        const T &root() const { return *m_rootNode->m_data; }
+        const T &root() const { return m_rootNode->m_data; }
+
+        //! Returns comparison criteria.
+
+        //! @return Copy of comparator used by binary search tree.
+        Compare key_comp() const { return this->comparator(); }
 
         //! Returns size of binary search tree.
 
@@ -510,41 +973,96 @@ namespace simple {
         //! Returns reference to minimum object in binary search tree.
 
         //! @return Reference to minimum object in binary search tree.
-        const T &min() const { return *(min(m_rootNode)->m_data); }
+        const T &min() const { return min(m_rootNode)->m_data; }
 
         //! Returns reference to maximum object in binary search tree.
 
         //! @return Reference to maximum object in binary search tree.
-        const T &max() const { return *(max(m_rootNode)->m_data); }
+        const T &max() const { return max(m_rootNode)->m_data; }
+
+        //! Writes binary search tree in text format, one element per line in order.
+
+        //! Numbers and strings are formatted by std::to_chars or copied to buffer of streamBuffer bytes,
+        //! which is written at once. Stream with other than default flags or locale, and other types, use << operator.
+        //! Floating point numbers are formatted like << operator does, with precision of stream.
+        //! @param os Output stream.
+        void write_text(std::ostream &os) const {
+            if (!os || !m_rootNode) return;
+            if constexpr (textElement) {
+                if (plainText(os) && !os.width() && os.precision() <= maxTextPrecision) {
+                    std::unique_ptr<char[]> buffer(new char[streamBuffer]);
+                    char *out = buffer.get(), *const end = buffer.get() + streamBuffer;
+                    for (auto curr = min(m_rootNode); curr; curr = successor(curr)) {
+                        if constexpr (std::is_same_v<T, std::string>) {
+                            if (static_cast<size_t>(end - out) <= curr->m_data.size()) {
+                                os.write(buffer.get(), out - buffer.get());
+                                out = buffer.get();
+                                if (curr->m_data.size() >= streamBuffer) {
+                                    os.write(curr->m_data.data(), static_cast<std::streamsize>(curr->m_data.size()));
+                                    os.put('\n');
+                                    continue;
+                                }
+                            }
+                            out = std::copy(curr->m_data.begin(), curr->m_data.end(), out);
+                        } else {
+                            if (end - out < static_cast<std::ptrdiff_t>(maxTextPrecision + 64)) {
+                                os.write(buffer.get(), out - buffer.get());
+                                out = buffer.get();
+                            }
+                            if constexpr (std::is_floating_point_v<T>)
+                                out = std::to_chars(out, end, curr->m_data, std::chars_format::general, static_cast<int>(os.precision())).ptr;
+                            else
+                                out = std::to_chars(out, end, curr->m_data).ptr;
+                        }
+                        *out++ = '\n';
+                    }
+                    os.write(buffer.get(), out - buffer.get());
+                    return;
+                }
+            }
+            for (auto curr = min(m_rootNode); curr && os; curr = successor(curr))
+                os << curr->m_data << '\n';
+        }
+
+        //! Reads whitespace separated elements in text format and adds them to binary search tree.
+
+        //! Numbers and strings are read in blocks of textBlock bytes and parsed by std::from_chars, stream with other
+        //! than default flags or locale, and other types, use >> operator. Reading stops at end of stream or at first
+        //! text which is not a number, then failbit is set, like after reading by >> operator. Stream is read in blocks,
+        //! so its position after bad text is not defined. Elements are linked in O(n) after sorting.
+        //! @param is Input stream.
+        void read_text(std::istream &is) { readText(is, nullptr); }
+
+        //! Reads whitespace separated elements in text format in parallel, see read_text(std::istream &).
+
+        //! Blocks are split at whitespace into pieces which are parsed by threads of pool, sorting is parallel too.
+        //! @param is Input stream.
+        //! @param pool Thread pool which executes tasks.
+        //! @param grain Approximate number of elements parsed by one task.
+        void read_text(std::istream &is, ThreadPool &pool, size_t grain = ThreadPool::defaultGrain) {
+            Parallel par{pool, grain ? grain : 1};
+            pool.run([&] { readText(is, &par); });
+        }
 
-        //! Output operator for file stream.
+        //! Output operator for stream.
 
-        //! Saves binary search tree in text format in file.
-        //! @param os Output file stream.
+        //! Saves binary search tree in text format, one element per line in order, see write_text().
+        //! @param os Output stream.
         //! @param source Binary search tree to save.
-        //! @return Output file stream.
-        friend std::ofstream &operator<<(std::ofstream &os, const BinarySearchTree &source) {
-            if (os.is_open() && source.m_rootNode) {
-                simple::LinkedList<T> res;
-                source.save(source.m_rootNode, res);
-                for (auto &e: res)
-                    os << e << "\n";
-            }
+        //! @return Output stream.
+        friend std::ostream &operator<<(std::ostream &os, const BinarySearchTree &source) {
+            source.write_text(os);
             return os;
         }
 
-        //! Input operator for file stream.
+        //! Input operator for stream.
 
-        //! Reads binary search tree in text format from file.
-        //! @param is Input file stream.
+        //! Reads binary search tree in text format, see read_text().
+        //! @param is Input stream.
         //! @param source Binary search tree to put data in.
-        //! @return Input file stream.
-        friend std::ifstream &operator>>(std::ifstream &is, BinarySearchTree &source) {
-            if (is.is_open()) {
-                T tmp;
-                while (is >> tmp)
-                    source.insert(tmp);
-            }
+        //! @return Input stream.
+        friend std::istream &operator>>(std::istream &is, BinarySearchTree &source) {
+            source.read_text(is);
             return is;
         }
 
@@ -568,112 +1086,1206 @@ namespace simple {
         //! Iterator to min element.
 
         //! @return begin iterator.
-        iterator begin() { return iterator(m_rootNode); }
+        iterator begin() const { return iterator(m_rootNode ? min(m_rootNode) : nullptr); }
 
         //! Iterator to end. (nullptr)
 
         //! @return end iterator.
-        iterator end() { return iterator(nullptr); }
+        iterator end() const { return iterator(nullptr); }
 
         //! Reverse iterator to max element.
 
         //! @return rbegin iterator.
-        reverse_iterator rbegin() { return reverse_iterator(m_rootNode); }
+        reverse_iterator rbegin() const { return reverse_iterator(m_rootNode ? max(m_rootNode) : nullptr); }
 
         //! Reverse iterator to end. (nullptr)
 
         //! @return rend iterator.
-        reverse_iterator rend() { return reverse_iterator(nullptr); }
+        reverse_iterator rend() const { return reverse_iterator(nullptr); }
+
+        //! Iterator to first element not less than data, O(h).
+
+        //! @param data Data to compare with.
+        //! @return Iterator to found element or end iterator.
+        iterator lower_bound(const T &data) const { return iterator(lowerBound(data)); }
+
+        //! Iterator to first element greater than data, O(h).
+
+        //! @param data Data to compare with.
+        //! @return Iterator to found element or end iterator.
+        iterator upper_bound(const T &data) const { return iterator(upperBound(data)); }
+
+        //! Range of elements equal to data.
+
+        //! @param data Data to compare with.
+        //! @return Pair of lower_bound and upper_bound iterators.
+        std::pair<iterator, iterator> equal_range(const T &data) const {
+            return {lower_bound(data), upper_bound(data)};
+        }
+
+        //! Iterator to element at given position in order, O(h).
+
+        //! Available only with OrderStatistics.
+        //! @param index Position of element, starting from zero.
+        //! @return Iterator to element or end iterator if index is out of range.
+        iterator nth(size_t index) const {
+            static_assert(OrderStatistics, "nth() requires OrderStatistics");
+            if (index >= m_numOfElements) return end();
+            const m_Node *curr = m_rootNode;
+            while (true) {
+                size_t leftSize = m_Node::sizeOf(curr->m_leftNode);
+                if (index < leftSize) {
+                    curr = curr->m_leftNode;
+                } else if (index == leftSize) {
+                    return iterator(curr);
+                } else {
+                    index -= leftSize + 1;
+                    curr = curr->m_rightNode;
+                }
+            }
+        }
+
+        //! Rank of data, O(h).
+
+        //! Available only with OrderStatistics.
+        //! @param data Data to compare with.
+        //! @return Number of elements less than data.
+        size_t rank(const T &data) const {
+            static_assert(OrderStatistics, "rank() requires OrderStatistics");
+            size_t res{};
+            const m_Node *curr = m_rootNode;
+            while (curr) {
+                if (less(curr->m_data, data)) {
+                    res += m_Node::sizeOf(curr->m_leftNode) + 1;
+                    curr = curr->m_rightNode;
+                } else {
+                    curr = curr->m_leftNode;
+                }
+            }
+            return res;
+        }
+
+        //! Range of elements in [first, last).
+
+        //! Range is found in O(h), iterating over it costs O(k) for k elements.
+        //! @param first Lower bound of range, included.
+        //! @param last Upper bound of range, excluded.
+        //! @return Range which can be iterated over, empty if last is not greater than first.
+        range_type range(const T &first, const T &last) const {
+            if (!less(first, last)) return range_type(end(), end());
+            return range_type(lower_bound(first), lower_bound(last));
+        }
+
+        //! Splits binary search tree at key.
+
+        //! Elements less than key stay in this tree, the rest (key included) is moved to returned tree.
+        //! Nodes are relinked, not copied, and both trees share allocator memory. Available only with
+        //! OrderStatistics, which gives sizes of both parts from root, so split takes O(log n) for red-black tree.
+        //! @param key Key to split at.
+        //! @return Binary search tree with elements not less than key.
+        BinarySearchTree split(const T &key) {
+            static_assert(OrderStatistics, "split() requires OrderStatistics");
+            BinarySearchTree res(this->comparator(), m_allocator.share());
+            m_Node *left, *found, *right;
+            size_t leftHeight, rightHeight;
+            splitNodes(m_rootNode, Balance::blackHeight(m_rootNode), key, left, leftHeight, found, right, rightHeight);
+            if (found) right = Balance::template join<m_Node>(nullptr, 0, found, right, rightHeight, rightHeight);
+            const size_t total = m_numOfElements;
+            m_rootNode = left;
+            res.m_rootNode = right;
+            m_numOfElements = m_Node::sizeOf(left);
+            res.m_numOfElements = total - m_numOfElements;
+            return res;
+        }
+
+        //! Joins other binary search tree to this one.
+
+        //! All elements of this tree should be less than all elements of other tree, then
+        //! nodes of other tree are relinked in O(log n) for red-black tree. Otherwise set_union() is used.
+        //! Other tree is empty afterwards.
+        //! @param other Binary search tree with greater elements.
+        void join(BinarySearchTree &other) {
+            if (&other == this || !other.m_rootNode) return;
+            if (m_rootNode && !less(max(m_rootNode)->m_data, min(other.m_rootNode)->m_data)) {
+                set_union(other);
+                return;
+            }
+            const size_t total = m_numOfElements + other.m_numOfElements;
+            m_Node *right = takeNodes(other);
+            size_t rightHeight = Balance::blackHeight(right);
+            m_Node *mid = detachMin(right, rightHeight);
+            size_t height;
+            m_rootNode = Balance::join(m_rootNode, Balance::blackHeight(m_rootNode), mid, right, rightHeight, height);
+            m_numOfElements = total;
+        }
+
+        //! Union with other binary search tree.
+
+        //! Nodes of other tree are relinked into this tree (moved to this tree's memory if allocators
+        //! do not share it), from equal elements the one from this tree is kept.
+        //! Takes O(m log(n/m + 1)) for red-black trees. Other tree is empty afterwards.
+        //! @param other Binary search tree to merge into this one.
+        void set_union(BinarySearchTree &other) {
+            if (&other == this) return;
+            const size_t total = m_numOfElements + other.m_numOfElements;
+            size_t duplicates{}, height;
+            m_Node *nodes = takeNodes(other);
+            m_rootNode = unite(m_rootNode, Balance::blackHeight(m_rootNode), nodes, Balance::blackHeight(nodes), height, duplicates);
+            m_numOfElements = total - duplicates;
+        }
+
+        //! Union with other binary search tree in parallel.
+
+        //! Works like set_union(other), but independent subtrees are merged by threads of pool.
+        //! @param other Binary search tree to merge into this one.
+        //! @param pool Thread pool.
+        //! @param grain Minimal number of elements merged by one task.
+        void set_union(BinarySearchTree &other, ThreadPool &pool, size_t grain = ThreadPool::defaultGrain) {
+            if (&other == this) return;
+            const size_t total = m_numOfElements + other.m_numOfElements;
+            size_t duplicates{}, height;
+            m_Node *nodes = takeNodes(other);
+            Parallel par{pool, grain};
+            pool.run([&] { m_rootNode = unite(m_rootNode, Balance::blackHeight(m_rootNode), nodes, Balance::blackHeight(nodes), height, duplicates, &par, total); });
+            m_numOfElements = total - duplicates;
+            clearDiscarded(par);
+        }
+
+        //! Intersection with other binary search tree.
+
+        //! Only elements present in both trees stay in this tree, its nodes are reused.
+        //! Takes O(m log(n/m + 1)) for red-black trees.
+        //! @param other Binary search tree to intersect with.
+        void set_intersection(const BinarySearchTree &other) {
+            if (&other == this) return;
+            size_t count{}, height;
+            m_rootNode = intersect(m_rootNode, Balance::blackHeight(m_rootNode), other.m_rootNode, height, count);
+            m_numOfElements = count;
+        }
+
+        //! Intersection with other binary search tree in parallel.
+
+        //! Works like set_intersection(other), but independent subtrees are processed by threads of pool.
+        //! @param other Binary search tree to intersect with.
+        //! @param pool Thread pool.
+        //! @param grain Minimal number of elements processed by one task.
+        void set_intersection(const BinarySearchTree &other, ThreadPool &pool, size_t grain = ThreadPool::defaultGrain) {
+            if (&other == this) return;
+            size_t count{}, height;
+            Parallel par{pool, grain};
+            pool.run([&] { m_rootNode = intersect(m_rootNode, Balance::blackHeight(m_rootNode), other.m_rootNode, height, count, &par, m_numOfElements + other.m_numOfElements); });
+            m_numOfElements = count;
+            clearDiscarded(par);
+        }
+
+        //! Difference with other binary search tree.
+
+        //! Elements present in other tree are removed from this tree.
+        //! Takes O(m log(n/m + 1)) for red-black trees.
+        //! @param other Binary search tree with elements to remove.
+        void set_difference(const BinarySearchTree &other) {
+            if (&other == this) {
+                clear();
+                return;
+            }
+            size_t removed{}, height;
+            m_rootNode = subtract(m_rootNode, Balance::blackHeight(m_rootNode), other.m_rootNode, height, removed);
+            m_numOfElements -= removed;
+        }
+
+        //! Difference with other binary search tree in parallel.
+
+        //! Works like set_difference(other), but independent subtrees are processed by threads of pool.
+        //! @param other Binary search tree with elements to remove.
+        //! @param pool Thread pool.
+        //! @param grain Minimal number of elements processed by one task.
+        void set_difference(const BinarySearchTree &other, ThreadPool &pool, size_t grain = ThreadPool::defaultGrain) {
+            if (&other == this) {
+                clear(pool, grain);
+                return;
+            }
+            size_t removed{}, height;
+            Parallel par{pool, grain};
+            pool.run([&] { m_rootNode = subtract(m_rootNode, Balance::blackHeight(m_rootNode), other.m_rootNode, height, removed, &par, m_numOfElements + other.m_numOfElements); });
+            m_numOfElements -= removed;
+            clearDiscarded(par);
+        }
+
+        //! Returns allocator of nodes.
+
+        //! @return Allocator using the same memory as this tree.
+        allocator_type get_allocator() { return m_allocator.share(); }
+
+        //! Extracts element from binary search tree.
+
+        //! Node is unlinked, not destroyed, so element is neither copied nor moved.
+        //! @param key Element to extract.
+        //! @return Node handle owning extracted node, empty if element was not found.
+        node_type extract(const T &key) {
+            auto node = const_cast<m_Node *>(search(m_rootNode, key));
+            if (!node) return {};
+            return node_type(unlink(node), m_allocator.share());
+        }
+
+        //! Inserts node owned by handle.
+
+        //! Node is relinked into tree if allocators share memory, otherwise its data is moved to new node.
+        //! @param node Node handle, it is empty afterwards unless equal element already exists.
+        //! @return Position of element, true if node was inserted, and handle with node which was not inserted.
+        insert_return_type insert(node_type &&node) {
+            if (!node) return {end(), false, node_type()};
+            m_Node *parent;
+            m_Node **link = findLink(node.m_node->m_data, parent);
+            if (*link) return {iterator(*link), false, std::move(node)};
+            m_Node *tmp;
+            if (m_allocator.sameMemory(node.m_allocator)) {
+                tmp = node.m_node;
+                node.m_node = nullptr;
+            } else {
+                tmp = createNode(std::move(node.m_node->m_data), nullptr, nullptr, nullptr);
+                node.reset();
+            }
+            attach(link, parent, tmp);
+            return {iterator(tmp), true, node_type()};
+        }
+
+        //! Moves elements of other tree to this tree.
+
+        //! Elements which already exist in this tree stay in other tree. If allocators share memory
+        //! nodes are relinked, no data is copied and allocator is not used,
+        //! takes O(m log(n/m + 1)) for red-black trees. Otherwise data is moved to new nodes.
+        //! @param other Binary search tree to take elements from.
+        void merge(BinarySearchTree &other) {
+            if (&other == this || !other.m_rootNode) return;
+            NodeArray rest;
+            rest.reserve(other.m_numOfElements);
+            if (m_allocator.sameMemory(other.m_allocator)) {
+                const size_t total = m_numOfElements + other.m_numOfElements;
+                size_t duplicates{}, height;
+                m_Node *nodes = other.m_rootNode;
+                other.m_rootNode = nullptr;
+                other.m_numOfElements = 0;
+                m_rootNode = unite(m_rootNode, Balance::blackHeight(m_rootNode), nodes, Balance::blackHeight(nodes), height, duplicates, nullptr, 0, &rest);
+                m_numOfElements = total - duplicates;
+            } else {
+                NodeArray all;
+                all.reserve(other.m_numOfElements);
+                for (auto curr = min(other.m_rootNode); curr; curr = successor(curr))
+                    all.push(const_cast<m_Node *>(curr));
+                other.m_rootNode = nullptr;
+                other.m_numOfElements = 0;
+                size_t i{};
+                try {
+                    for (; i < all.size(); ++i) {
+                        m_Node *parent;
+                        m_Node **link = findLink(all[i]->m_data, parent);
+                        if (*link) {
+                            rest.push(all[i]);
+                        } else {
+                            attach(link, parent, createNode(std::move(all[i]->m_data), nullptr, nullptr, nullptr));
+                            other.destroyNode(all[i]);
+                        }
+                    }
+                } catch (...) {
+                    for (; i < all.size(); ++i) rest.push(all[i]);
+                    other.link(rest.data(), rest.size());
+                    throw;
+                }
+            }
+            other.link(rest.data(), rest.size());
+        }
 
     private:
-        //! Private save function.
+        //! State of parallel operation.
+        struct Parallel {
+            ThreadPool &m_pool;                  //!< Thread pool.
+            size_t m_grain;                      //!< Minimal number of elements processed by one task.
+            std::atomic<m_Node *> m_discarded{}; //!< Subtrees to destroy after operation, linked by parent pointers.
+        };
+
+        //! Runs two functions, in parallel if operation is parallel and big enough.
+
+        //! @param par State of parallel operation, nullptr for sequential one.
+        //! @param estimate Estimated number of elements processed by both functions.
+        //! @param first First function.
+        //! @param second Second function.
+        template<typename F1, typename F2>
+        static void fork(Parallel *par, size_t estimate, F1 &&first, F2 &&second) {
+            if (par && estimate >= par->m_grain) {
+                par->m_pool.invoke(first, second);
+            } else {
+                first();
+                second();
+            }
+        }
 
-        //! Stores content of binary search tree in order in LinkedList for further use.
-        //! Uses recursion.
-        //! @param root Pointer to local root.
-        //! @param result LinkedList which result will be stored.
-        void save(m_Node *root, LinkedList<T> &result) const {
-            auto tmp = root;
-            if (tmp) {
-                result.pushBack(*tmp->m_data);
-                save(tmp->m_leftNode, result);
-                save(tmp->m_rightNode, result);
+        //! Calls function for every index in range, in parallel if operation is parallel.
+
+        //! @param begin First index.
+        //! @param end Index past last one.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        //! @param function Function called with index.
+        template<typename F>
+        static void parallelFor(size_t begin, size_t end, Parallel *par, F &&function) {
+            if (!par || end - begin < 2 * par->m_grain) {
+                for (; begin < end; ++begin) function(begin);
+                return;
             }
+            const size_t mid = begin + (end - begin) / 2;
+            par->m_pool.invoke([&] { parallelFor(begin, mid, par, function); },
+                               [&] { parallelFor(mid, end, par, function); });
         }
 
-        //! Private remove function.
+        //! Destroys detached subtree, or leaves it for clearDiscarded() if it cannot be done now.
+
+        //! Allocators which are not thread safe cannot free nodes during parallel operation.
+        //! @param root Root of detached subtree.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        void discard(m_Node *root, Parallel *par) {
+            if constexpr (!m_Allocator::threadSafe) {
+                if (par) {
+                    root->m_parent = par->m_discarded.load(std::memory_order_relaxed);
+                    while (!par->m_discarded.compare_exchange_weak(root->m_parent, root, std::memory_order_release, std::memory_order_relaxed)) {}
+                    return;
+                }
+            }
+            clear(root);
+        }
 
-        //! If node exist deletes it.
-        //! @param node Node to delete
-        void remove(const m_Node *node) {
-            if (!node) return;
-            // If no child is present
-            if (!node->m_leftNode && !node->m_rightNode) {
-                auto tmpParent = node->m_parent;
-                if (node == tmpParent->m_leftNode)
-                    tmpParent->m_leftNode = nullptr;
-                else
-                    tmpParent->m_rightNode = nullptr;
+        //! Destroys subtrees left by discard().
 
-                if (node == m_rootNode) {
-                    delete node;
-                    m_rootNode = nullptr;
-                } else {
-                    delete node;
+        //! @param par State of finished parallel operation.
+        void clearDiscarded(Parallel &par) {
+            m_Node *root = par.m_discarded.load(std::memory_order_acquire);
+            while (root) {
+                m_Node *next = root->m_parent;
+                root->m_parent = nullptr;
+                clear(root);
+                root = next;
+            }
+        }
+
+        //! Growable array of pointers to nodes, used by bulk building.
+        class NodeArray {
+        public:
+            //! Default constructor.
+            NodeArray() = default;
+
+            //! Copy constructor, deleted.
+            NodeArray(const NodeArray &other) = delete;
+
+            //! Copy operator, deleted.
+            NodeArray &operator=(const NodeArray &other) = delete;
+
+            //! Destructor, deletes array, nodes are not touched.
+            ~NodeArray() { delete[] m_nodes; }
+
+            //! Makes sure array can hold given number of nodes.
+
+            //! @param capacity Number of nodes.
+            void reserve(size_t capacity) {
+                if (capacity <= m_capacity) return;
+                auto tmp = new m_Node *[capacity];
+                std::copy(m_nodes, m_nodes + m_size, tmp);
+                delete[] m_nodes;
+                m_nodes = tmp;
+                m_capacity = capacity;
+            }
+
+            //! Adds node at the end of array.
+
+            //! @param node Pointer to node.
+            void push(m_Node *node) {
+                if (m_size == m_capacity) reserve(m_capacity ? m_capacity * 2 : 16);
+                m_nodes[m_size++] = node;
+            }
+
+            //! Sets number of nodes in array.
+
+            //! Added pointers are set to nullptr.
+            //! @param size New size.
+            void resize(size_t size) {
+                reserve(size);
+                if (size > m_size) std::fill(m_nodes + m_size, m_nodes + size, nullptr);
+                m_size = size;
+            }
+
+            //! Returns pointer to array.
+
+            //! @return Pointer to first element.
+            m_Node **data() { return m_nodes; }
+
+            //! Returns number of nodes in array.
+
+            //! @return Number of nodes.
+            [[nodiscard]] size_t size() const { return m_size; }
+
+            //! Returns node at given index.
+
+            //! @param index Index of node.
+            //! @return Pointer to node.
+            m_Node *operator[](size_t index) const { return m_nodes[index]; }
+
+        private:
+            m_Node **m_nodes{}; //!< Array of pointers to nodes.
+            size_t m_size{};    //!< Number of nodes in array.
+            size_t m_capacity{};//!< Capacity of array.
+        };
+
+        //! Clone function.
+
+        //! Copies subtree node by node, with data, color and subtree size, walks without recursion.
+        //! @tparam MoveData If true data is moved from source nodes instead of copied.
+        //! @param root Root of subtree to copy.
+        //! @return Root of copy, its parent is nullptr.
+        template<bool MoveData = false>
+        m_Node *clone(const m_Node *root) {
+            if (!root) return nullptr;
+            m_Node *res = cloneNode<MoveData>(root, nullptr);
+            try {
+                const m_Node *src = root;
+                m_Node *dst = res;
+                while (dst) {
+                    if (src->m_leftNode && !dst->m_leftNode) {
+                        dst->m_leftNode = cloneNode<MoveData>(src->m_leftNode, dst);
+                        src = src->m_leftNode;
+                        dst = dst->m_leftNode;
+                    } else if (src->m_rightNode && !dst->m_rightNode) {
+                        dst->m_rightNode = cloneNode<MoveData>(src->m_rightNode, dst);
+                        src = src->m_rightNode;
+                        dst = dst->m_rightNode;
+                    } else {
+                        // both subtrees copied, go back up
+                        src = src->m_parent;
+                        dst = dst->m_parent;
+                    }
                 }
-                m_numOfElements--;
-            }
-            // If one child is present
-            else if (!node->m_leftNode) {
-                m_Node *tmpChild = node->m_rightNode;
-                m_Node *tmpParent = node->m_parent;
-                tmpChild->m_parent = tmpParent;
-                if (tmpParent) {
-                    if (node == tmpParent->m_leftNode)
-                        tmpParent->m_leftNode = tmpChild;
-                    else
-                        tmpParent->m_rightNode = tmpChild;
+            } catch (...) {
+                clear(res);
+                throw;
+            }
+            return res;
+        }
+
+        //! Copies single node without its children.
+
+        //! @tparam MoveData If true data is moved from source node instead of copied.
+        //! @param node Node to copy.
+        //! @param parent Parent of copy.
+        //! @return Copy of node.
+        template<bool MoveData>
+        m_Node *cloneNode(const m_Node *node, m_Node *parent) {
+            m_Node *res;
+            if constexpr (MoveData)
+                res = createNode(std::move(const_cast<m_Node *>(node)->m_data), parent, nullptr, nullptr);
+            else
+                res = createNode(node->m_data, parent, nullptr, nullptr);
+            res->m_red = node->m_red;
+            if constexpr (OrderStatistics) res->m_size = node->m_size;
+            return res;
+        }
+
+        //! Takes all nodes from other tree.
+
+        //! If allocators do not share memory, nodes are recreated in this tree's memory with moved data.
+        //! @param other Tree to take nodes from, it is empty afterwards.
+        //! @return Root of detached nodes.
+        m_Node *takeNodes(BinarySearchTree &other) {
+            m_Node *res = other.m_rootNode;
+            if (res && !m_allocator.sameMemory(other.m_allocator)) {
+                res = clone<true>(other.m_rootNode);
+                other.clear();
+            }
+            other.m_rootNode = nullptr;
+            other.m_numOfElements = 0;
+            return res;
+        }
+
+        //! Detaches node from its parent.
+
+        //! Node becomes root of separate tree, so it is colored black, which keeps red-black rules.
+        //! @param node Node to detach, may be nullptr.
+        //! @return The same node.
+        static m_Node *detach(m_Node *node) {
+            if (node) {
+                node->m_parent = nullptr;
+                node->m_red = false;
+            }
+            return node;
+        }
+
+        //! Black height of child of node after it is detached.
+
+        //! Detached child is colored black, so red child gains one black level.
+        //! @param node Node.
+        //! @param height Black height of node.
+        //! @param child Child of node, may be nullptr.
+        //! @return Black height of detached child.
+        static size_t detachedHeight(const m_Node *node, size_t height, const m_Node *child) {
+            return Balance::childHeight(node, height) + (child && child->m_red);
+        }
+
+        //! Unlinks minimal node from subtree.
+
+        //! @param root Reference to root of detached subtree, not empty.
+        //! @param height Reference to black height of subtree, updated after unlink.
+        //! @return Unlinked node.
+        m_Node *detachMin(m_Node *&root, size_t &height) {
+            auto node = const_cast<m_Node *>(min(root));
+            m_Node *tmpChild = node->m_rightNode;
+            m_Node *tmpParent = node->m_parent;
+            if (tmpChild) tmpChild->m_parent = tmpParent;
+            if (!tmpParent)
+                root = tmpChild;
+            else
+                tmpParent->m_leftNode = tmpChild;
+            if constexpr (OrderStatistics)
+                for (m_Node *tmp = tmpParent; tmp; tmp = tmp->m_parent) tmp->m_size--;
+            if (Balance::eraseFixup(root, tmpChild, tmpParent, node->m_red)) --height;
+            node->m_parent = node->m_leftNode = node->m_rightNode = nullptr;
+            return node;
+        }
+
+        //! Joins two detached subtrees, all elements of left are less than elements of right.
+
+        //! @param left Root of left subtree.
+        //! @param leftHeight Black height of left subtree.
+        //! @param right Root of right subtree.
+        //! @param rightHeight Black height of right subtree.
+        //! @param height Set to black height of joined subtree.
+        //! @return Root of joined subtree.
+        m_Node *join(m_Node *left, size_t leftHeight, m_Node *right, size_t rightHeight, size_t &height) {
+            if (!left) {
+                height = rightHeight;
+                return right;
+            }
+            if (!right) {
+                height = leftHeight;
+                return left;
+            }
+            m_Node *mid = detachMin(right, rightHeight);
+            return Balance::join(left, leftHeight, mid, right, rightHeight, height);
+        }
+
+        //! Splits detached subtree at key.
+
+        //! Walks down to key, then joins nodes on the path bottom-up, without recursion.
+        //! Black heights of nodes on the path are tracked, so no join has to compute them.
+        //! @param root Root of detached subtree.
+        //! @param height Black height of detached subtree.
+        //! @param key Key to split at.
+        //! @param left Set to root of subtree with elements less than key.
+        //! @param leftHeight Set to black height of left.
+        //! @param found Set to detached node equal to key, or nullptr.
+        //! @param right Set to root of subtree with elements greater than key.
+        //! @param rightHeight Set to black height of right.
+        void splitNodes(m_Node *root, size_t height, const T &key, m_Node *&left, size_t &leftHeight, m_Node *&found, m_Node *&right, size_t &rightHeight) {
+            left = found = right = nullptr;
+            leftHeight = rightHeight = 0;
+            // height is black height of curr
+            m_Node *curr = root;
+            while (curr) {
+                if (less(key, curr->m_data)) {
+                    if (!curr->m_leftNode) break;
+                    height = Balance::childHeight(curr, height);
+                    curr = curr->m_leftNode;
+                } else if (less(curr->m_data, key)) {
+                    if (!curr->m_rightNode) break;
+                    height = Balance::childHeight(curr, height);
+                    curr = curr->m_rightNode;
+                } else {
+                    found = curr;
+                    leftHeight = detachedHeight(curr, height, curr->m_leftNode);
+                    rightHeight = detachedHeight(curr, height, curr->m_rightNode);
+                    left = detach(curr->m_leftNode);
+                    right = detach(curr->m_rightNode);
+                    curr = curr->m_parent;
+                    if (curr) height = Balance::parentHeight(curr, height);
+                    found->m_parent = found->m_leftNode = found->m_rightNode = nullptr;
+                    break;
                 }
-                if (node == m_rootNode) {
-                    delete node;
-                    m_rootNode = tmpChild;
+            }
+            while (curr) {
+                m_Node *tmpParent = curr->m_parent;
+                const size_t parentHeight = tmpParent ? Balance::parentHeight(tmpParent, height) : 0;
+                if (less(key, curr->m_data)) {
+                    const size_t childHeight = detachedHeight(curr, height, curr->m_rightNode);
+                    right = Balance::join(right, rightHeight, curr, detach(curr->m_rightNode), childHeight, rightHeight);
                 } else {
-                    delete node;
+                    const size_t childHeight = detachedHeight(curr, height, curr->m_leftNode);
+                    left = Balance::join(detach(curr->m_leftNode), childHeight, curr, left, leftHeight, leftHeight);
                 }
-                m_numOfElements--;
-            } else if (!node->m_rightNode) {
-                m_Node *tmpChild = node->m_leftNode;
-                m_Node *tmpParent = node->m_parent;
-                tmpChild->m_parent = tmpParent;
-                if (tmpParent) {
-                    if (node == tmpParent->m_leftNode)
-                        tmpParent->m_leftNode = tmpChild;
-                    else
-                        tmpParent->m_rightNode = tmpChild;
+                curr = tmpParent;
+                height = parentHeight;
+            }
+        }
+
+        //! Union of detached subtrees.
+
+        //! @param a Root of subtree of this tree.
+        //! @param aHeight Black height of a.
+        //! @param b Root of subtree with nodes taken from other tree.
+        //! @param bHeight Black height of b.
+        //! @param height Set to black height of union.
+        //! @param duplicates Increased by number of equal elements, nodes from b are destroyed for them.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        //! @param estimate Estimated number of elements in both subtrees.
+        //! @param rest If not nullptr, nodes from b equal to nodes from a are pushed here in order
+        //! instead of being destroyed, it needs capacity for all of them. Only for sequential operation.
+        //! @return Root of union.
+        m_Node *unite(m_Node *a, size_t aHeight, m_Node *b, size_t bHeight, size_t &height, size_t &duplicates,
+                      Parallel *par = nullptr, size_t estimate = 0, NodeArray *rest = nullptr) {
+            if (!a) {
+                height = bHeight;
+                return b;
+            }
+            if (!b) {
+                height = aHeight;
+                return a;
+            }
+            const size_t bLeftHeight = detachedHeight(b, bHeight, b->m_leftNode);
+            const size_t bRightHeight = detachedHeight(b, bHeight, b->m_rightNode);
+            m_Node *bLeft = detach(b->m_leftNode);
+            m_Node *bRight = detach(b->m_rightNode);
+            b->m_leftNode = b->m_rightNode = nullptr;
+            m_Node *aLeft, *found, *aRight;
+            size_t aLeftHeight, aRightHeight;
+            splitNodes(a, aHeight, b->m_data, aLeft, aLeftHeight, found, aRight, aRightHeight);
+            m_Node *left, *right;
+            size_t leftHeight, rightHeight;
+            size_t rightDuplicates{};
+            fork(
+                    par, estimate,
+                    [&] {
+                        left = unite(aLeft, aLeftHeight, bLeft, bLeftHeight, leftHeight, duplicates, par, estimate / 2, rest);
+                        if (found && rest) rest->push(b);
+                    },
+                    [&] { right = unite(aRight, aRightHeight, bRight, bRightHeight, rightHeight, rightDuplicates, par, estimate / 2, rest); });
+            duplicates += rightDuplicates;
+            if (found) {
+                if (!rest) discard(b, par);
+                b = found;
+                ++duplicates;
+            }
+            return Balance::join(left, leftHeight, b, right, rightHeight, height);
+        }
+
+        //! Intersection of detached subtree with subtree of other tree.
+
+        //! @param a Root of subtree of this tree.
+        //! @param aHeight Black height of a.
+        //! @param b Root of subtree of other tree, it is not modified.
+        //! @param height Set to black height of intersection.
+        //! @param count Increased by number of elements in result.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        //! @param estimate Estimated number of elements in both subtrees.
+        //! @return Root of intersection.
+        m_Node *intersect(m_Node *a, size_t aHeight, const m_Node *b, size_t &height, size_t &count, Parallel *par = nullptr, size_t estimate = 0) {
+            height = 0;
+            if (!a) return nullptr;
+            if (!b) {
+                discard(a, par);
+                return nullptr;
+            }
+            m_Node *aLeft, *found, *aRight;
+            size_t aLeftHeight, aRightHeight;
+            splitNodes(a, aHeight, b->m_data, aLeft, aLeftHeight, found, aRight, aRightHeight);
+            m_Node *left, *right;
+            size_t leftHeight, rightHeight;
+            size_t rightCount{};
+            fork(par, estimate, [&] { left = intersect(aLeft, aLeftHeight, b->m_leftNode, leftHeight, count, par, estimate / 2); },
+                 [&] { right = intersect(aRight, aRightHeight, b->m_rightNode, rightHeight, rightCount, par, estimate / 2); });
+            count += rightCount;
+            if (!found) return join(left, leftHeight, right, rightHeight, height);
+            ++count;
+            return Balance::join(left, leftHeight, found, right, rightHeight, height);
+        }
+
+        //! Difference of detached subtree and subtree of other tree.
+
+        //! @param a Root of subtree of this tree.
+        //! @param aHeight Black height of a.
+        //! @param b Root of subtree of other tree, it is not modified.
+        //! @param height Set to black height of difference.
+        //! @param removed Increased by number of removed elements.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        //! @param estimate Estimated number of elements in both subtrees.
+        //! @return Root of difference.
+        m_Node *subtract(m_Node *a, size_t aHeight, const m_Node *b, size_t &height, size_t &removed, Parallel *par = nullptr, size_t estimate = 0) {
+            height = aHeight;
+            if (!a || !b) return a;
+            m_Node *aLeft, *found, *aRight;
+            size_t aLeftHeight, aRightHeight;
+            splitNodes(a, aHeight, b->m_data, aLeft, aLeftHeight, found, aRight, aRightHeight);
+            m_Node *left, *right;
+            size_t leftHeight, rightHeight;
+            size_t rightRemoved{};
+            fork(par, estimate, [&] { left = subtract(aLeft, aLeftHeight, b->m_leftNode, leftHeight, removed, par, estimate / 2); },
+                 [&] { right = subtract(aRight, aRightHeight, b->m_rightNode, rightHeight, rightRemoved, par, estimate / 2); });
+            removed += rightRemoved;
+            if (found) {
+                discard(found, par);
+                ++removed;
+            }
+            return join(left, leftHeight, right, rightHeight, height);
+        }
+
+        //! Bulk insert function.
+
+        //! Existing nodes and nodes created by fill are sorted and from equal elements only the first one
+        //! is kept (existing ones go first), then whole tree is relinked in O(n).
+        //! @param expected Expected number of new nodes, used to reserve memory.
+        //! @param fill Function which pushes new nodes to NodeArray.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        template<typename Fill>
+        void bulkInsert(size_t expected, Fill fill, Parallel *par = nullptr) {
+            NodeArray nodes;
+            nodes.reserve(m_numOfElements + expected);
+            m_allocator.reserve(expected);
+            for (auto curr = m_rootNode ? min(m_rootNode) : nullptr; curr; curr = successor(curr))
+                nodes.push(const_cast<m_Node *>(curr));
+            const size_t existing = nodes.size();
+            try {
+                fill(nodes);
+            } catch (...) {
+                for (size_t i = existing; i < nodes.size(); ++i)
+                    if (nodes[i]) destroyNode(nodes[i]);
+                throw;
+            }
+            if (nodes.size() == existing) return;
+
+            auto nodeLess = [this](const m_Node *a, const m_Node *b) { return less(a->m_data, b->m_data); };
+            auto nodeGreater = [this](const m_Node *a, const m_Node *b) { return less(b->m_data, a->m_data); };
+            m_Node **first = nodes.data();
+            m_Node **last = first + nodes.size();
+            if (!existing && std::is_sorted(first, last, nodeGreater)) {
+                // reversed input, equal neighbours are swapped too, so first of them has to be restored
+                std::reverse(first, last);
+                for (m_Node **it = first; it != last;) {
+                    m_Node **runEnd = std::upper_bound(it, last, *it, nodeLess);
+                    std::reverse(it, runEnd);
+                    it = runEnd;
                 }
-                if (node == m_rootNode) {
-                    delete node;
-                    m_rootNode = tmpChild;
+            } else if (!std::is_sorted(first, last, nodeLess)) {
+                sortNodes(first, last, par);
+            }
+
+            // remove equal elements, first one is kept
+            size_t unique{};
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                if (unique && !nodeLess(first[unique - 1], first[i]))
+                    destroyNode(first[i]);
+                else
+                    first[unique++] = first[i];
+            }
+            nodes.resize(unique);
+            link(first, unique, par);
+        }
+
+        //! Stable sort of nodes.
+
+        //! Parallel operation sorts both halves in parallel and merges them.
+        //! @param first Pointer to first node.
+        //! @param last Pointer past last node.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        void sortNodes(m_Node **first, m_Node **last, Parallel *par) {
+            auto nodeLess = [this](const m_Node *a, const m_Node *b) { return less(a->m_data, b->m_data); };
+            const auto count = static_cast<size_t>(last - first);
+            if (!par || count < 2 * par->m_grain) {
+                std::stable_sort(first, last, nodeLess);
+                return;
+            }
+            m_Node **mid = first + count / 2;
+            par->m_pool.invoke([&] { sortNodes(first, mid, par); }, [&] { sortNodes(mid, last, par); });
+            std::inplace_merge(first, mid, last, nodeLess);
+        }
+
+        //! Link function.
+
+        //! Links sorted nodes into perfectly balanced tree, which replaces current tree.
+        //! Deepest level is colored red, all other nodes black, which satisfies red-black rules.
+        //! @param nodes Array of sorted nodes.
+        //! @param count Number of nodes.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        void link(m_Node **nodes, size_t count, Parallel *par = nullptr) {
+            size_t depth{};
+            for (size_t tmp = count; tmp > 1; tmp /= 2) ++depth;
+            m_rootNode = link(nodes, count, nullptr, 0, depth, par);
+            m_numOfElements = count;
+        }
+
+        //! Private link function.
+
+        //! Middle node becomes local root, both halves are linked recursively, recursion depth is O(log n).
+        //! @param nodes Array of sorted nodes.
+        //! @param count Number of nodes.
+        //! @param parent Parent of local root.
+        //! @param depth Depth of local root.
+        //! @param redDepth Depth of deepest level.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        //! @return Local root.
+        m_Node *link(m_Node **nodes, size_t count, m_Node *parent, size_t depth, size_t redDepth, Parallel *par) {
+            if (!count) return nullptr;
+            size_t mid = count / 2;
+            m_Node *node = nodes[mid];
+            node->m_parent = parent;
+            fork(par, count, [&] { node->m_leftNode = link(nodes, mid, node, depth + 1, redDepth, par); },
+                 [&] { node->m_rightNode = link(nodes + mid + 1, count - mid - 1, node, depth + 1, redDepth, par); });
+            node->m_red = depth && depth == redDepth;
+            node->update();
+            return node;
+        }
+
+        //! Creates node.
+
+        //! Obtains memory from allocator and constructs node in it.
+        //! @param args Arguments forwarded to constructor of node.
+        //! @return Pointer to new node.
+        template<typename... Args>
+        m_Node *createNode(Args &&...args) {
+            m_Node *mem = m_allocator.allocate();
+            try {
+                return new (mem) m_Node(std::forward<Args>(args)...);
+            } catch (...) {
+                m_allocator.deallocate(mem);
+                throw;
+            }
+        }
+
+        //! Destroys node.
+
+        //! Calls destructor of node and gives its memory back to allocator.
+        //! @param node Node to destroy.
+        void destroyNode(const m_Node *node) {
+            auto tmp = const_cast<m_Node *>(node);
+            tmp->~m_Node();
+            m_allocator.deallocate(tmp);
+        }
+
+        //! Reads raw block written by simple::writeRaw(), magic number is already read.
+
+        //! Elements are read in chunks of rawChunk bytes, incomplete block is cut to whole elements.
+        //! @param is Input stream.
+        void readRaw(std::istream &is) {
+            uint64_t header[2]{};
+            if (!is.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != sizeof(T)) return;
+            auto count = static_cast<size_t>(header[1]);
+            // damaged header cannot make buffer bigger than rest of seekable stream
+            const auto pos = is.tellg();
+            if (pos != std::streampos(-1) && is.seekg(0, std::ios::end)) {
+                count = std::min(count, static_cast<size_t>(is.tellg() - pos) / sizeof(T));
+                is.seekg(pos);
+            }
+            typedef std::aligned_storage_t<sizeof(T), alignof(T)> Storage;
+            const size_t chunk = std::min(count, std::max<size_t>(rawChunk / sizeof(T), 1));
+            std::unique_ptr<Storage[]> buffer(new Storage[chunk]);
+            // count of stream which cannot seek is not trusted for reservation, array grows while reading
+            bulkInsert(pos != std::streampos(-1) ? count : chunk, [&](NodeArray &nodes) {
+                for (size_t left = count; left;) {
+                    is.read(reinterpret_cast<char *>(buffer.get()), static_cast<std::streamsize>(std::min(left, chunk) * sizeof(T)));
+                    const size_t read = static_cast<size_t>(is.gcount()) / sizeof(T);
+                    for (size_t i = 0; i < read; ++i)
+                        nodes.push(createNode(*std::launder(reinterpret_cast<const T *>(&buffer[i])), nullptr, nullptr, nullptr));
+                    if (!is) break;
+                    left -= read;
+                }
+            });
+        }
+
+        //! Reads packed blocks written by simple::writePacked(), magic number is already read.
+
+        //! Blocks are decoded from buffer of rawChunk bytes, refilled from stream, damaged or incomplete block ends reading.
+        //! Decoded elements come in order, so they are linked in O(n).
+        //! @param is Input stream.
+        void readPacked(std::istream &is) {
+            typedef std::make_unsigned_t<T> Unsigned;
+            uint64_t header[2]{};
+            if (!is.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != sizeof(T)) return;
+            auto count = static_cast<size_t>(header[1]);
+            // every block takes at least width and first element, which limits count of seekable stream
+            const auto pos = is.tellg();
+            if (pos != std::streampos(-1) && is.seekg(0, std::ios::end)) {
+                const auto blocks = static_cast<size_t>(is.tellg() - pos) / (1 + sizeof(T));
+                count = std::min(count, blocks > SIZE_MAX / packedBlock ? count : blocks * packedBlock);
+                is.seekg(pos);
+            }
+            const size_t maxBlock = 1 + sizeof(T) + (packedBlock - 1) * sizeof(uint64_t);
+            // slack after data lets decoder load whole words at end of block
+            std::unique_ptr<char[]> buffer(new char[rawChunk + 2 * sizeof(uint64_t)]());
+            size_t begin{}, end{};
+            bulkInsert(pos != std::streampos(-1) ? count : std::min(count, rawChunk), [&](NodeArray &nodes) {
+                for (size_t left = count; left;) {
+                    if (end - begin < maxBlock && is) {
+                        std::memmove(buffer.get(), buffer.get() + begin, end - begin);
+                        end -= begin;
+                        begin = 0;
+                        is.read(buffer.get() + end, static_cast<std::streamsize>(rawChunk - end));
+                        end += static_cast<size_t>(is.gcount());
+                        std::memset(buffer.get() + end, 0, 2 * sizeof(uint64_t));
+                    }
+                    if (end - begin < 1 + sizeof(T)) break;
+                    const char *in = buffer.get() + begin;
+                    const unsigned width = static_cast<unsigned char>(*in++);
+                    const size_t size = std::min(left, packedBlock);
+                    const size_t bytes = 1 + sizeof(T) + ((size - 1) * width + 7) / 8;
+                    if (width > 64 || end - begin < bytes) break;
+
+                    auto value = static_cast<Unsigned>(loadLittle(in, sizeof(T)));
+                    in += sizeof(T);
+                    nodes.push(createNode(static_cast<T>(value), nullptr, nullptr, nullptr));
+                    const uint64_t mask = width < 64 ? (uint64_t(1) << width) - 1 : ~uint64_t(0);
+                    for (size_t i = 0, bit = 0; i + 1 < size; ++i, bit += width) {
+                        const char *at = in + bit / 8;
+                        const unsigned shift = bit % 8;
+                        uint64_t zigzag = loadLittle(at, sizeof(uint64_t)) >> shift;
+                        if (shift + width > 64) zigzag |= static_cast<uint64_t>(static_cast<unsigned char>(at[8])) << (64 - shift);
+                        zigzag &= mask;
+                        const auto delta = static_cast<Unsigned>(static_cast<Unsigned>(zigzag >> 1) ^ static_cast<Unsigned>(0 - static_cast<Unsigned>(zigzag & 1)));
+                        value = static_cast<Unsigned>(value + delta);
+                        nodes.push(createNode(static_cast<T>(value), nullptr, nullptr, nullptr));
+                    }
+                    begin += bytes;
+                    left -= size;
+                }
+            });
+        }
+
+        //! Returns true if stream uses default number formatting and classic locale, so std::to_chars and std::from_chars give the same text.
+
+        //! @param stream Stream.
+        //! @return True if stream formats numbers like std::to_chars.
+        static bool plainText(const std::ios_base &stream) {
+            const auto format = std::ios::basefield | std::ios::floatfield | std::ios::showpos | std::ios::showpoint |
+                                std::ios::uppercase | std::ios::boolalpha | std::ios::skipws;
+            return (stream.flags() & format) == (std::ios::dec | std::ios::skipws) && stream.getloc() == std::locale::classic();
+        }
+
+        //! Returns true if character is whitespace in classic locale.
+
+        //! @param ch Character.
+        //! @return True for space, tab, new line, vertical tab, form feed and carriage return.
+        static bool isSpace(char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); }
+
+        //! Reads elements in text format, in parallel if par is given.
+
+        //! Block ends at last whitespace, the rest of it is moved to start of next block. Block grows
+        //! if single element does not fit.
+        //! @param is Input stream.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        void readText(std::istream &is, Parallel *par) {
+            if (!is) return;
+            if constexpr (textElement) {
+                if (plainText(is)) {
+                    size_t capacity = textBlock, kept{};
+                    std::unique_ptr<char[]> buffer(new char[capacity]);
+                    bool failed{};
+                    bulkInsert(0, [&](NodeArray &nodes) {
+                        while (!failed) {
+                            is.read(buffer.get() + kept, static_cast<std::streamsize>(capacity - kept));
+                            const size_t size = kept + static_cast<size_t>(is.gcount());
+                            const bool last = !is;
+                            size_t end = size;
+                            if (!last)
+                                while (end && !isSpace(buffer[end - 1])) --end;
+                            if (!end && !last) {
+                                std::unique_ptr<char[]> bigger(new char[capacity * 2]);
+                                std::memcpy(bigger.get(), buffer.get(), size);
+                                buffer = std::move(bigger);
+                                capacity *= 2;
+                                kept = size;
+                                continue;
+                            }
+                            failed = parseText(buffer.get(), buffer.get() + end, nodes, par);
+                            kept = size - end;
+                            std::memmove(buffer.get(), buffer.get() + end, kept);
+                            if (last) break;
+                        }
+                    }, par);
+                    if (failed) is.setstate(std::ios::failbit);
+                    return;
+                }
+            }
+            bulkInsert(0, [&](NodeArray &nodes) {
+                T tmp;
+                while (is >> tmp)
+                    nodes.push(createNode(std::move(tmp), nullptr, nullptr, nullptr));
+            }, par);
+        }
+
+        //! Parses block of text, pieces of block are parsed in parallel if par is given and allocator is thread safe.
+
+        //! @param first Start of text.
+        //! @param last End of text, it is whitespace or end of stream.
+        //! @param nodes Array which created nodes are added to, in order of text.
+        //! @param par State of parallel operation, nullptr for sequential one.
+        //! @return True if parsing stopped at text which is not a number.
+        bool parseText(const char *first, const char *last, NodeArray &nodes, Parallel *par) {
+            const size_t pieceSize = par ? par->m_grain * textBytesPerElement : 0;
+            if constexpr (m_Allocator::threadSafe) {
+                if (par && static_cast<size_t>(last - first) >= 2 * pieceSize) {
+                    const size_t pieces = static_cast<size_t>(last - first) / pieceSize;
+                    std::unique_ptr<const char *[]> bounds(new const char *[pieces + 1]);
+                    bounds[0] = first;
+                    bounds[pieces] = last;
+                    for (size_t i = 1; i < pieces; ++i) {
+                        const char *bound = std::max(first + i * pieceSize, bounds[i - 1]);
+                        while (bound != last && !isSpace(*bound)) ++bound;
+                        bounds[i] = bound;
+                    }
+                    std::unique_ptr<NodeArray[]> parts(new NodeArray[pieces]);
+                    std::unique_ptr<bool[]> failed(new bool[pieces]());
+                    auto discard = [&](size_t from) {
+                        for (size_t i = from; i < pieces; ++i)
+                            for (size_t j = 0; j < parts[i].size(); ++j) destroyNode(parts[i][j]);
+                    };
+                    try {
+                        Parallel pieceTasks{par->m_pool, 1};
+                        parallelFor(0, pieces, &pieceTasks, [&](size_t i) { failed[i] = parsePiece(bounds[i], bounds[i + 1], parts[i]); });
+                        size_t total = nodes.size();
+                        for (size_t i = 0; i < pieces; ++i) total += parts[i].size();
+                        nodes.reserve(total);
+                    } catch (...) {
+                        discard(0);
+                        throw;
+                    }
+                    for (size_t i = 0; i < pieces; ++i) {
+                        for (size_t j = 0; j < parts[i].size(); ++j) nodes.push(parts[i][j]);
+                        if (failed[i]) {
+                            discard(i + 1);
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+            }
+            return parsePiece(first, last, nodes);
+        }
+
+        //! Parses whitespace separated elements by std::from_chars.
+
+        //! Like >> operator, number can start with +, and unsigned number with -, which negates it.
+        //! @param first Start of text.
+        //! @param last End of text.
+        //! @param nodes Array which created nodes are added to.
+        //! @return True if parsing stopped at text which is not a number.
+        bool parsePiece(const char *first, const char *last, NodeArray &nodes) {
+            for (const char *pos = first;;) {
+                while (pos != last && isSpace(*pos)) ++pos;
+                if (pos == last) return false;
+                if constexpr (std::is_same_v<T, std::string>) {
+                    const char *end = std::find_if(pos, last, isSpace);
+                    nodes.push(createNode(std::string(pos, end), nullptr, nullptr, nullptr));
+                    pos = end;
                 } else {
-                    delete node;
+                    bool negate{};
+                    if (*pos == '+' || (std::is_unsigned_v<T> && *pos == '-')) negate = *pos++ == '-';
+                    T value{};
+                    const auto result = std::from_chars(pos, last, value);
+                    if (result.ec != std::errc()) return true;
+                    if constexpr (std::is_unsigned_v<T>)
+                        if (negate) value = static_cast<T>(0 - value);
+                    nodes.push(createNode(value, nullptr, nullptr, nullptr));
+                    pos = result.ptr;
                 }
-                m_numOfElements--;
             }
+        }
 
-            // If both children are present
-            else {
-                auto succ = successor(node);
-                auto successorsParent = succ->m_parent;
+        //! Reads elements written by simple::writeStrings(), number of elements is already read.
 
-                if (successorsParent != node)
-                    successorsParent->m_leftNode = succ->m_rightNode;
-                else
-                    successorsParent->m_rightNode = succ->m_rightNode;
+        //! Every string is read at once, std::string elements are taken directly, other types parsed by >> operator.
+        //! @param is Input stream.
+        //! @param count Number of elements.
+        void readStrings(std::istream &is, size_t count) {
+            bulkInsert(count, [&](NodeArray &nodes) {
+                std::string data;
+                std::istringstream ss;
+                for (size_t i = 0; i < count; ++i) {
+                    size_t strSize;
+                    if (!is.read(reinterpret_cast<char *>(&strSize), sizeof(strSize))) break;
+                    data.resize(strSize);
+                    if (!is.read(data.data(), static_cast<std::streamsize>(strSize))) break;
+                    if constexpr (std::is_same_v<T, std::string>) {
+                        nodes.push(createNode(std::move(data), nullptr, nullptr, nullptr));
+                        data = std::string();
+                    } else {
+                        T tmp;
+                        ss.clear();
+                        ss.str(data);
+                        ss >> tmp;
+                        nodes.push(createNode(std::move(tmp), nullptr, nullptr, nullptr));
+                    }
+                }
+            });
+        }
+
+        //! Private remove function.
+
+        //! If node exist deletes it.
+        //! @param node Node to delete
+        void remove(const m_Node *node) {
+            if (node) destroyNode(unlink(node));
+        }
 
-                *node->m_data = *succ->m_data;
-                delete succ;
-                m_numOfElements--;
+        //! Unlink function.
+
+        //! Removes node from tree without destroying it. Node with two children is replaced
+        //! by its successor, which is spliced into its place with its color and subtree size,
+        //! so data of no node is copied or moved and pointers to other elements stay valid.
+        //! @param node Node to unlink.
+        //! @return Detached node.
+        m_Node *unlink(const m_Node *node) {
+            auto target = const_cast<m_Node *>(node);
+            m_Node *tmpChild;
+            m_Node *tmpParent;
+            bool removedRed;
+            if (target->m_leftNode && target->m_rightNode) {
+                // successor has no left child, its right child takes its place
+                auto succ = const_cast<m_Node *>(min(target->m_rightNode));
+                tmpChild = succ->m_rightNode;
+                removedRed = succ->m_red;
+                if (succ->m_parent == target) {
+                    tmpParent = succ;
+                } else {
+                    tmpParent = succ->m_parent;
+                    replace(succ, tmpChild);
+                    succ->m_rightNode = target->m_rightNode;
+                    succ->m_rightNode->m_parent = succ;
+                }
+                replace(target, succ);
+                succ->m_leftNode = target->m_leftNode;
+                succ->m_leftNode->m_parent = succ;
+                succ->m_red = target->m_red;
+                if constexpr (OrderStatistics) succ->m_size = target->m_size;
+            } else {
+                tmpChild = target->m_leftNode ? target->m_leftNode : target->m_rightNode;
+                tmpParent = target->m_parent;
+                removedRed = target->m_red;
+                replace(target, tmpChild);
             }
+
+            if constexpr (OrderStatistics)
+                for (m_Node *tmp = tmpParent; tmp; tmp = tmp->m_parent) tmp->m_size--;
+            Balance::eraseFixup(m_rootNode, tmpChild, tmpParent, removedRed);
+            m_numOfElements--;
+            target->m_parent = target->m_leftNode = target->m_rightNode = nullptr;
+            target->m_red = false;
+            target->update();
+            return target;
+        }
+
+        //! Puts other node in place of node in its parent.
+
+        //! @param node Node to replace.
+        //! @param other Node which takes its place, may be nullptr.
+        void replace(m_Node *node, m_Node *other) {
+            m_Node *tmpParent = node->m_parent;
+            if (other) other->m_parent = tmpParent;
+            if (!tmpParent)
+                m_rootNode = other;
+            else if (node == tmpParent->m_leftNode)
+                tmpParent->m_leftNode = other;
+            else
+                tmpParent->m_rightNode = other;
         }
 
         //! Predecessor function.
@@ -685,6 +2297,7 @@ namespace simple {
             if (root->m_leftNode) return max(root->m_leftNode);
             auto tmpParent = root->m_parent;
             while (tmpParent && root == tmpParent->m_leftNode) {
+                root = tmpParent;
                 tmpParent = tmpParent->m_parent;
             }
             return tmpParent;
@@ -699,6 +2312,7 @@ namespace simple {
             if (root->m_rightNode) return min(root->m_rightNode);
             auto tmpParent = root->m_parent;
             while (tmpParent && root == tmpParent->m_rightNode) {
+                root = tmpParent;
                 tmpParent = tmpParent->m_parent;
             }
             return tmpParent;
@@ -733,91 +2347,181 @@ namespace simple {
         //! Clear function.
 
         //! Clears memory from all object in binary search tree.
+        //! Walks tree without recursion, so depth of tree does not matter.
         //! @param root Local root.
         void clear(m_Node *root) {
-            if (root) {
-                clear(root->m_leftNode);
-                clear(root->m_rightNode);
-                delete root;
+            m_Node *stop = root ? root->m_parent : nullptr;
+            while (root != stop) {
+                if (root->m_leftNode) {
+                    root = root->m_leftNode;
+                } else if (root->m_rightNode) {
+                    root = root->m_rightNode;
+                } else {
+                    m_Node *tmpParent = root->m_parent;
+                    if (tmpParent) {
+                        if (root == tmpParent->m_leftNode)
+                            tmpParent->m_leftNode = nullptr;
+                        else
+                            tmpParent->m_rightNode = nullptr;
+                    }
+                    destroyNode(root);
+                    root = tmpParent;
+                }
             }
         }
 
-        //! Private insert function.
-
-        //! Creates new node with provided data, inserts it in correct place.
-        //! @param rootPtr Pointer to local root.
-        //! @param parentPtr Pointer to a parent node.
-        //! @param data Data to insert in node.
-        //! @return Pointer to inserted node.
-        const m_Node *insert(m_Node **rootPtr, m_Node *parentPtr, const T &data) {
-            auto root = *rootPtr;
-            if (!root) {
-                *rootPtr = new m_Node(data, parentPtr, nullptr, nullptr);
-                m_numOfElements++;
-                return *rootPtr;
+        //! Parallel clear function.
+
+        //! Both subtrees are destroyed in parallel while they are bigger than grain.
+        //! Allocator has to be thread safe.
+        //! @param root Root of detached subtree.
+        //! @param par State of parallel operation.
+        //! @param estimate Estimated number of elements in subtree.
+        void clear(m_Node *root, Parallel *par, size_t estimate) {
+            if (!root) return;
+            if (estimate < par->m_grain) {
+                clear(root);
+                return;
             }
+            m_Node *left = detach(root->m_leftNode);
+            m_Node *right = detach(root->m_rightNode);
+            destroyNode(root);
+            par->m_pool.invoke([&] { clear(left, par, estimate / 2); }, [&] { clear(right, par, estimate / 2); });
+        }
 
-            if (data == *root->m_data) {
-                // do nothing and return pointer to element
-                return root;
+        //! Finds place for data.
+
+        //! Walks down from root without recursion.
+        //! @param data Data to find place for.
+        //! @param parent Set to parent of returned link.
+        //! @return Pointer to link holding node with equal data, or to empty link where data belongs.
+        m_Node **findLink(const T &data, m_Node *&parent) {
+            parent = nullptr;
+            m_Node **link = &m_rootNode;
+            while (m_Node *curr = *link) {
+                if (less(data, curr->m_data))
+                    link = &curr->m_leftNode;
+                else if (less(curr->m_data, data))
+                    link = &curr->m_rightNode;
+                else
+                    break;
+                parent = curr;
             }
+            return link;
+        }
 
-            if (m_compFunc(data, *root->m_data)) {
-                return insert(&(root->m_leftNode), root, data);
-            } else {
-                return insert(&(root->m_rightNode), root, data);
-            }
+        //! Links new node into tree.
+
+        //! @param link Empty link returned by findLink().
+        //! @param parent Parent returned by findLink().
+        //! @param node Node to link.
+        void attach(m_Node **link, m_Node *parent, m_Node *node) {
+            node->m_parent = parent;
+            *link = node;
+            m_numOfElements++;
+            if constexpr (OrderStatistics)
+                for (m_Node *tmp = parent; tmp; tmp = tmp->m_parent) tmp->m_size++;
+            Balance::insertFixup(m_rootNode, node);
         }
 
         //! Private insert function.
 
-        //! Creates new node with provided data (moves it), inserts it in correct place.
-        //! @param rootPtr Pointer to local root.
-        //! @param parentPtr Pointer to a parent node.
+        //! Creates new node with provided data (copies or moves it), inserts it in correct place.
+        //! Nothing is created if equal data already exists.
         //! @param data Data to insert in node.
-        //! @return Pointer to inserted node.
-        const m_Node *insert(m_Node **rootPtr, m_Node *parentPtr, T &&data) {
-            auto root = *rootPtr;
-            if (!root) {
-                *rootPtr = new m_Node(std::move(data), parentPtr, nullptr, nullptr);
-                m_numOfElements++;
-                return *rootPtr;
-            }
-
-            if (data == *root->m_data) {
-                // do nothing and return pointer to element
-                return root;
-            }
-
-            if (m_compFunc(data, *root->m_data)) {
-                return insert(&(root->m_leftNode), root, std::move(data));
-            } else {
-                return insert(&(root->m_rightNode), root, std::move(data));
-            }
+        //! @return Pointer to inserted node or to node with equal data.
+        template<typename V>
+        const m_Node *insertValue(V &&data) {
+            m_Node *parent;
+            m_Node **link = findLink(data, parent);
+            if (*link) return *link;
+            m_Node *node = createNode(std::forward<V>(data), parent, nullptr, nullptr);
+            attach(link, parent, node);
+            return node;
         }
 
         //! Private search functon.
 
-        //! Searches for data in subtree starting from root.
+        //! Searches for data in subtree starting from root, walks down without recursion.
         //! @param root Local root.
         //! @param data Data we are searching for.
         //! @return Pointer to node with data if exist, nullptr otherwise.
         const m_Node *search(m_Node *root, const T &data) const {
-            if (!root) return nullptr;
+            while (root) {
+                if (less(data, root->m_data))
+                    root = root->m_leftNode;
+                else if (less(root->m_data, data))
+                    root = root->m_rightNode;
+                else
+                    return root;
+            }
+            return nullptr;
+        }
 
-            if (data == *root->m_data) return root;
+        //! Lower bound function.
 
-            if (data < *root->m_data)
-                return search(root->m_leftNode, data);
-            else
-                return search(root->m_rightNode, data);
+        //! @param data Data to compare with.
+        //! @return First node not less than data, nullptr if there is none.
+        const m_Node *lowerBound(const T &data) const {
+            const m_Node *res = nullptr;
+            const m_Node *curr = m_rootNode;
+            while (curr) {
+                if (!less(curr->m_data, data)) {
+                    res = curr;
+                    curr = curr->m_leftNode;
+                } else {
+                    curr = curr->m_rightNode;
+                }
+            }
+            return res;
+        }
+
+        //! Upper bound function.
+
+        //! @param data Data to compare with.
+        //! @return First node greater than data, nullptr if there is none.
+        const m_Node *upperBound(const T &data) const {
+            const m_Node *res = nullptr;
+            const m_Node *curr = m_rootNode;
+            while (curr) {
+                if (less(data, curr->m_data)) {
+                    res = curr;
+                    curr = curr->m_leftNode;
+                } else {
+                    curr = curr->m_rightNode;
+                }
+            }
+            return res;
         }
 
+        //! Compares two elements with comparison criteria.
+
+        //! @param a First element.
+        //! @param b Second element.
+        //! @return True if a goes before b.
+        bool less(const T &a, const T &b) const { return this->comparator()(a, b); }
+
     private:
+        static constexpr size_t streamBuffer = size_t(1) << 18;//!< Size of buffer of file streams and callbacks.
+        static constexpr size_t textBlock = size_t(1) << 22;   //!< Bytes read at once by text reading.
+        static constexpr size_t textBytesPerElement = 16;      //!< Estimated length of element in text, sets size of parallel pieces.
+        static constexpr std::streamsize maxTextPrecision = 64;//!< Highest precision of stream formatted by std::to_chars.
+        //! True if elements are read and written by std::from_chars and std::to_chars, characters and bool are excluded.
+        static constexpr bool textElement = std::is_same_v<T, std::string> ||
+                                            (std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char> &&
+                                             !std::is_same_v<T, signed char> && !std::is_same_v<T, unsigned char> && !std::is_same_v<T, wchar_t> &&
+                                             !std::is_same_v<T, char16_t> && !std::is_same_v<T, char32_t>);
+
         size_t m_numOfElements{};                            //!< Stores number of nodes in binary search tree.
         m_Node *m_rootNode{};                                //!< Pointer to a root node of a binary search tree.
-        std::function<bool(const T &, const T &)> m_compFunc;//!< Comparison criteria functor
+        m_Allocator m_allocator;                             //!< Allocator of nodes.
     };
 
+    //! Binary search tree with order statistics.
+
+    //! Nodes store sizes of their subtrees, tree is balanced with red-black rules by default.
+    template<typename T, typename Compare = std::less<T>, typename Balance = RedBlack, template<typename> class NodeAllocator = HeapNodeAllocator>
+    using OrderStatisticTree = BinarySearchTree<T, Compare, Balance, NodeAllocator, true>;
+
 }// namespace simple
 #endif// BST_H
@@ -0,0 +1,670 @@
+/**
+ * @file ConcurrentBST.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief template header file for concurrent binary search tree with optimistic lock coupling and lock-free reads
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef CONCURRENTBST_H
+#define CONCURRENTBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "BST.h"
+#include "Epoch.h"
+
+namespace simple {
+    //! Optimistic version lock.
+
+    //! Readers do not lock, they remember version and check later that it did not change.
+    //! Writer upgrades remembered version to lock, unlocking increases version.
+    //! Bit 0 of version marks obsolete (removed) node, bit 1 marks locked node.
+    class OptimisticLock {
+    public:
+        //! Starts optimistic read.
+
+        //! @param version Set to current version.
+        //! @return False if node is locked or obsolete, reader has to restart.
+        bool readLock(uint64_t &version) const {
+            version = m_version.load(std::memory_order_acquire);
+            return !(version & (lockedBit | obsoleteBit));
+        }
+
+        //! Checks if version did not change since readLock(), everything read before is consistent then.
+
+        //! @param version Version returned by readLock().
+        //! @return True if version did not change.
+        [[nodiscard]] bool validate(uint64_t version) const {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return m_version.load(std::memory_order_relaxed) == version;
+        }
+
+        //! Upgrades optimistic read to write lock.
+
+        //! @param version Version returned by readLock().
+        //! @return False if version changed in meantime, writer has to restart.
+        bool upgrade(uint64_t version) {
+            return m_version.compare_exchange_strong(version, version + lockedBit, std::memory_order_acquire);
+        }
+
+        //! Unlocks write lock and increases version.
+        void unlock() { m_version.fetch_add(lockedBit, std::memory_order_release); }
+
+        //! Unlocks write lock and marks node obsolete, all readers of it will restart.
+        void unlockObsolete() { m_version.fetch_add(lockedBit | obsoleteBit, std::memory_order_release); }
+
+    private:
+        static constexpr uint64_t obsoleteBit = 1;//!< Bit of removed node.
+        static constexpr uint64_t lockedBit = 2;  //!< Bit of locked node.
+
+        std::atomic<uint64_t> m_version{4};//!< Version with lock and obsolete bits.
+    };
+
+    //! Node of concurrent binary search tree.
+
+    //! Data never changes after node is linked, child pointers are atomic and guarded by lock.
+    //! Removed node is retired to epoch domain.
+    template<typename T>
+    struct ConcurrentNode : EpochRetired {
+        //! Constructor.
+
+        //! @param value Data to store in node.
+        template<typename V>
+        explicit ConcurrentNode(V &&value) : m_data(std::forward<V>(value)) {}
+
+        T m_data;                                  //!< Data.
+        std::atomic<ConcurrentNode *> m_leftNode{};//!< Left child.
+        std::atomic<ConcurrentNode *> m_rightNode{};//!< Right child.
+        OptimisticLock m_lock;                     //!< Version lock guarding children.
+    };
+
+    //! Concurrent binary search tree class.
+
+    //! Unbalanced binary search tree which can be used by many threads at the same time.
+    //! Every node has optimistic version lock. Operations walk down with lock coupling: version of
+    //! child is read before version of parent is validated, if anything changed operation restarts.
+    //! Writers lock only nodes they modify: insert locks parent of new node, remove locks parent and
+    //! removed node and, if it has two children, whole path to its successor, which is spliced into its place.
+    //! Changes are published with atomic pointer stores.
+    //!
+    //! Searches and iterators take no locks and do no read-modify-write operations, they follow child
+    //! pointers with plain acquire loads, so writer holding lock of upper node does not delay them.
+    //! Only splice of successor can hide existing element from reader, and only from reader whose last
+    //! step to the right was from the removed node, which is locked before the splice. Reader remembers
+    //! version of that node and repeats descent only if it was locked or changed, so it waits only for
+    //! writers modifying the node where it turned right, never for writers in other parts of tree.
+    //! Removed nodes are retired to EpochDomain and destroyed when no reader can see them.
+    template<typename T, typename Compare = std::less<T>>
+    class ConcurrentBinarySearchTree : private CompareStorage<Compare> {
+    private:
+        typedef CompareStorage<Compare> m_CompareStorage;
+        typedef ConcurrentNode<T> m_Node;
+        typedef HeapNodeAllocator<m_Node> m_Allocator;
+
+    public:
+        typedef Compare compare_type;
+
+        //! Forward iterator which can be used while other threads modify tree.
+
+        //! Iterator keeps critical section of epoch domain, so element it points to stays valid even if it is
+        //! removed. Every increment descends from root to next greater element, elements inserted or removed
+        //! concurrently may or may not be visited, but elements present all the time are visited in order.
+        //! Iterator has to be used and destroyed by thread which created it.
+        class iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef T value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const T *pointer;
+            typedef const T &reference;
+
+            //! Default constructor.
+            iterator() = default;
+
+            //! Dereference operator.
+
+            //! @return Reference to element, elements never change.
+            const T &operator*() const { return m_node->m_data; }
+
+            //! Arrow operator.
+
+            //! @return Pointer to element.
+            const T *operator->() const { return &m_node->m_data; }
+
+            //! Prefix increment, moves to next greater element.
+
+            //! @return Iterator.
+            iterator &operator++() {
+                m_node = m_tree->upperBound(m_node->m_data);
+                return *this;
+            }
+
+            //! Postfix increment, moves to next greater element.
+
+            //! @return Iterator before increment.
+            iterator operator++(int) {
+                iterator tmp(*this);
+                ++*this;
+                return tmp;
+            }
+
+            //! Equality operator.
+
+            //! @param other Other iterator.
+            //! @return True if both iterators point to the same node.
+            bool operator==(const iterator &other) const { return m_node == other.m_node; }
+
+            //! Inequality operator.
+
+            //! @param other Other iterator.
+            //! @return True if iterators point to different nodes.
+            bool operator!=(const iterator &other) const { return m_node != other.m_node; }
+
+        private:
+            friend class ConcurrentBinarySearchTree;
+
+            //! Constructor used by tree, critical section has to be entered before node was read.
+
+            //! @param tree Tree.
+            //! @param guard Critical section in which node was read.
+            //! @param node Node or nullptr for end.
+            iterator(const ConcurrentBinarySearchTree *tree, const EpochGuard &guard, const m_Node *node) : m_guard(guard), m_tree(tree), m_node(node) {}
+
+            EpochGuard m_guard;                         //!< Critical section keeping node alive.
+            const ConcurrentBinarySearchTree *m_tree{};//!< Tree.
+            const m_Node *m_node{};                     //!< Current node, nullptr for end.
+        };
+
+        typedef iterator const_iterator;
+
+        //! Default constructor.
+
+        //! @param comp Comparison criteria.
+        explicit ConcurrentBinarySearchTree(const Compare &comp = Compare()) : m_CompareStorage(comp) {}
+
+        //! Initializer list constructor.
+
+        //! @param init Initializer list.
+        //! @param comp Comparison criteria.
+        ConcurrentBinarySearchTree(std::initializer_list<T> init, const Compare &comp = Compare()) : m_CompareStorage(comp) {
+            for (const auto &e: init) insert(e);
+        }
+
+        //! Copy constructor, deleted.
+        ConcurrentBinarySearchTree(const ConcurrentBinarySearchTree &other) = delete;
+
+        //! Copy operator, deleted.
+        ConcurrentBinarySearchTree &operator=(const ConcurrentBinarySearchTree &other) = delete;
+
+        //! Destructor.
+
+        //! Calls clear() function which clears memory.
+        ~ConcurrentBinarySearchTree() { clear(); }
+
+        //! Inserts data to binary search tree.
+
+        //! @param data Data.
+        //! @return True if data was inserted, false if equal data already exists.
+        bool insert(const T &data) { return insertValue(data); }
+
+        //! Inserts data to binary search tree. (moves)
+
+        //! @param data Data.
+        //! @return True if data was inserted, false if equal data already exists.
+        bool insert(T &&data) { return insertValue(std::move(data)); }
+
+        //! Removes data from binary search tree.
+
+        //! @param data Data to remove.
+        //! @return True if data was removed.
+        bool remove(const T &data) {
+            EpochGuard guard;
+            for (unsigned attempt = 0;; ++attempt) {
+                if (attempt) backoff(attempt);
+                Position pos;
+                if (!find(data, pos)) {
+                    if (pos.m_restart) continue;
+                    return false;
+                }
+                if (removeAt(pos)) return true;
+            }
+        }
+
+        //! Search for data, lock-free.
+
+        //! @param data Data to search for.
+        //! @return True if equal data exists.
+        bool search(const T &data) const {
+            EpochGuard guard;
+            return lookup(data);
+        }
+
+        //! Search for data, copies found element, lock-free.
+
+        //! Reference to element cannot be returned, because it can be removed by other thread.
+        //! @param data Data to search for.
+        //! @param result Set to copy of equal element if it exists.
+        //! @return True if equal data exists.
+        bool search(const T &data, T &result) const {
+            EpochGuard guard;
+            const m_Node *node = lookup(data);
+            if (node) result = node->m_data;
+            return node;
+        }
+
+        //! Returns iterator to the smallest element.
+
+        //! @return Iterator.
+        iterator begin() const {
+            EpochGuard guard;
+            return {this, guard, minimum()};
+        }
+
+        //! Returns iterator past the greatest element.
+
+        //! @return Iterator.
+        iterator end() const { return {this, EpochGuard(), nullptr}; }
+
+        //! Returns size of binary search tree.
+
+        //! @return Number of elements, may be outdated while other threads modify tree.
+        [[nodiscard]] size_t size() const { return m_numOfElements.load(std::memory_order_relaxed); }
+
+        //! Returns comparison criteria.
+
+        //! @return Copy of comparator used by binary search tree.
+        Compare key_comp() const { return this->comparator(); }
+
+        //! Clears binary search tree.
+
+        //! Must not run concurrently with other operations, removed nodes are destroyed by epoch domain.
+        void clear() {
+            m_Node *node = m_rootNode.load(std::memory_order_relaxed);
+            // rotate left children up, so every node is destroyed after its left subtree without stack
+            while (node) {
+                if (m_Node *left = node->m_leftNode.load(std::memory_order_relaxed)) {
+                    node->m_leftNode.store(left->m_rightNode.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                    left->m_rightNode.store(node, std::memory_order_relaxed);
+                    node = left;
+                } else {
+                    m_Node *right = node->m_rightNode.load(std::memory_order_relaxed);
+                    destroyNode(node);
+                    node = right;
+                }
+            }
+            m_rootNode.store(nullptr, std::memory_order_relaxed);
+            m_numOfElements.store(0, std::memory_order_relaxed);
+            EpochDomain::global().reclaim();
+        }
+
+    private:
+        //! Result of descent.
+        struct Position {
+            OptimisticLock *m_parentLock{};//!< Lock of parent, or of root pointer.
+            uint64_t m_parentVersion{};    //!< Version of parent lock.
+            std::atomic<m_Node *> *m_link{};//!< Link from parent to node.
+            m_Node *m_node{};              //!< Found node or nullptr.
+            uint64_t m_version{};          //!< Version of found node.
+            bool m_restart{};              //!< True if descent has to be restarted.
+        };
+
+        //! Path of nodes with versions, locked together by remove.
+        class LockPath {
+        public:
+            //! Default constructor.
+            LockPath() = default;
+
+            //! Copy constructor, deleted.
+            LockPath(const LockPath &other) = delete;
+
+            //! Copy operator, deleted.
+            LockPath &operator=(const LockPath &other) = delete;
+
+            //! Adds node at the end of path.
+
+            //! @param node Node.
+            //! @param version Version of node.
+            void push(m_Node *node, uint64_t version) {
+                if (m_size == m_capacity) {
+                    size_t capacity = m_capacity * 2;
+                    std::unique_ptr<Entry[]> tmp(new Entry[capacity]);
+                    std::copy(m_entries, m_entries + m_size, tmp.get());
+                    m_heap = std::move(tmp);
+                    m_entries = m_heap.get();
+                    m_capacity = capacity;
+                }
+                m_entries[m_size++] = {node, version};
+            }
+
+            //! Locks all nodes of path, in order.
+
+            //! @return Number of locked nodes, all of them if equal to size().
+            size_t lock() {
+                size_t i{};
+                while (i < m_size && m_entries[i].m_node->m_lock.upgrade(m_entries[i].m_version)) ++i;
+                return i;
+            }
+
+            //! Unlocks first count nodes of path.
+
+            //! @param count Number of locked nodes.
+            void unlock(size_t count) {
+                for (size_t i = 0; i < count; ++i) m_entries[i].m_node->m_lock.unlock();
+            }
+
+            //! Returns number of nodes in path.
+
+            //! @return Number of nodes.
+            [[nodiscard]] size_t size() const { return m_size; }
+
+            //! Returns last node of path.
+
+            //! @return Pointer to node.
+            m_Node *back() const { return m_entries[m_size - 1].m_node; }
+
+        private:
+            //! Node with its version.
+            struct Entry {
+                m_Node *m_node;   //!< Node.
+                uint64_t m_version;//!< Version read by descent.
+            };
+
+            Entry m_inline[32]{};          //!< Storage for short paths.
+            std::unique_ptr<Entry[]> m_heap;//!< Storage for long paths.
+            Entry *m_entries{m_inline};    //!< Current storage.
+            size_t m_size{};               //!< Number of nodes.
+            size_t m_capacity{32};         //!< Capacity of current storage.
+        };
+
+        //! Compares data using comparison criteria.
+
+        //! @param a First element.
+        //! @param b Second element.
+        //! @return True if a is less than b.
+        bool less(const T &a, const T &b) const { return this->comparator()(a, b); }
+
+        //! Waits a bit before restart of operation.
+
+        //! @param attempt Number of failed attempts.
+        static void backoff(unsigned attempt) {
+            if (attempt % 8 == 0) std::this_thread::yield();
+        }
+
+        //! Node from which lock-free reader last went right, with its version.
+
+        //! Splice moves successor of removed node up to its place. Successor is the smallest element
+        //! right of removed node, so reader which missed it went right from removed node and only left
+        //! afterwards. Remover locks removed node before it changes any link, so if version of that node
+        //! was clean when reader turned and is the same after descent, no splice could hide anything from reader.
+        class RightTurn {
+        public:
+            //! Remembers node and reads its version, called before reader goes right from node.
+
+            //! @param node Node.
+            void set(const m_Node *node) {
+                m_node = node;
+                m_clean = node->m_lock.readLock(m_version);
+            }
+
+            //! Checks that result of descent is correct.
+
+            //! @return True if reader never went right, or node where it last did was not locked nor changed.
+            [[nodiscard]] bool valid() const { return !m_node || (m_clean && m_node->m_lock.validate(m_version)); }
+
+        private:
+            const m_Node *m_node{};//!< Node where reader last went right.
+            uint64_t m_version{};  //!< Version of node read before turn.
+            bool m_clean{};        //!< True if node was not locked nor obsolete.
+        };
+
+        //! Lock-free search, caller has to be in critical section.
+
+        //! Found node is always correct, descent is repeated only if it missed and could pass spliced successor.
+        //! @param data Data to search for.
+        //! @return Found node or nullptr.
+        const m_Node *lookup(const T &data) const {
+            for (unsigned attempt = 0;; ++attempt) {
+                if (attempt) backoff(attempt);
+                RightTurn turn;
+                const m_Node *node = m_rootNode.load(std::memory_order_acquire);
+                while (node) {
+                    if (less(data, node->m_data)) {
+                        node = node->m_leftNode.load(std::memory_order_acquire);
+                    } else if (less(node->m_data, data)) {
+                        turn.set(node);
+                        node = node->m_rightNode.load(std::memory_order_acquire);
+                    } else {
+                        return node;
+                    }
+                }
+                if (turn.valid()) return nullptr;
+            }
+        }
+
+        //! Lock-free search of the smallest element, caller has to be in critical section.
+
+        //! Descent never goes right, so no splice can hide the smallest element from it.
+        //! @return The smallest node or nullptr.
+        const m_Node *minimum() const {
+            const m_Node *node = m_rootNode.load(std::memory_order_acquire);
+            while (node) {
+                const m_Node *left = node->m_leftNode.load(std::memory_order_acquire);
+                if (!left) return node;
+                node = left;
+            }
+            return nullptr;
+        }
+
+        //! Lock-free search of the smallest element greater than data, caller has to be in critical section.
+
+        //! @param data Data.
+        //! @return Found node or nullptr.
+        const m_Node *upperBound(const T &data) const {
+            for (unsigned attempt = 0;; ++attempt) {
+                if (attempt) backoff(attempt);
+                RightTurn turn;
+                const m_Node *node = m_rootNode.load(std::memory_order_acquire);
+                const m_Node *bound{};
+                while (node) {
+                    if (less(data, node->m_data)) {
+                        bound = node;
+                        node = node->m_leftNode.load(std::memory_order_acquire);
+                    } else {
+                        turn.set(node);
+                        node = node->m_rightNode.load(std::memory_order_acquire);
+                    }
+                }
+                if (turn.valid()) return bound;
+            }
+        }
+
+        //! Optimistic descent with lock coupling, used by writers.
+
+        //! Version of every node is read before version of its parent is validated, so node
+        //! was child of parent at time of validation.
+        //! @param data Data to search for.
+        //! @param pos Set to found node or to empty link where data belongs, with versions.
+        //! @return True if node was found, if false check m_restart.
+        bool find(const T &data, Position &pos) const {
+            auto &rootLock = const_cast<OptimisticLock &>(m_rootLock);
+            pos.m_parentLock = &rootLock;
+            pos.m_link = const_cast<std::atomic<m_Node *> *>(&m_rootNode);
+            if (!rootLock.readLock(pos.m_parentVersion)) return restart(pos);
+            for (;;) {
+                m_Node *node = pos.m_link->load(std::memory_order_acquire);
+                if (!node) {
+                    if (!pos.m_parentLock->validate(pos.m_parentVersion)) return restart(pos);
+                    pos.m_node = nullptr;
+                    return false;
+                }
+                uint64_t version;
+                if (!node->m_lock.readLock(version) || !pos.m_parentLock->validate(pos.m_parentVersion)) return restart(pos);
+                std::atomic<m_Node *> *link;
+                if (less(data, node->m_data)) {
+                    link = &node->m_leftNode;
+                } else if (less(node->m_data, data)) {
+                    link = &node->m_rightNode;
+                } else {
+                    pos.m_node = node;
+                    pos.m_version = version;
+                    return true;
+                }
+                pos.m_parentLock = &node->m_lock;
+                pos.m_parentVersion = version;
+                pos.m_link = link;
+            }
+        }
+
+        //! Marks descent for restart.
+
+        //! @param pos Position to mark.
+        //! @return Always false.
+        static bool restart(Position &pos) {
+            pos.m_restart = true;
+            return false;
+        }
+
+        //! Private insert function.
+
+        //! New node is created once and linked under write lock of its parent.
+        //! @param data Data to insert.
+        //! @return True if data was inserted.
+        template<typename V>
+        bool insertValue(V &&data) {
+            EpochGuard guard;
+            m_Node *node{};
+            for (unsigned attempt = 0;; ++attempt) {
+                if (attempt) backoff(attempt);
+                Position pos;
+                // data may be already moved to node
+                if (find(node ? node->m_data : static_cast<const T &>(data), pos)) {
+                    if (!pos.m_node->m_lock.validate(pos.m_version)) continue;
+                    if (node) destroyNode(node);
+                    return false;
+                }
+                if (pos.m_restart) continue;
+                if (!node) node = createNode(std::forward<V>(data));
+                if (!pos.m_parentLock->upgrade(pos.m_parentVersion)) continue;
+                pos.m_link->store(node, std::memory_order_release);
+                pos.m_parentLock->unlock();
+                m_numOfElements.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        //! Removes found node.
+
+        //! @param pos Position of node returned by find().
+        //! @return False if something changed and remove has to restart.
+        bool removeAt(const Position &pos) {
+            m_Node *node = pos.m_node;
+            m_Node *left = node->m_leftNode.load(std::memory_order_acquire);
+            m_Node *right = node->m_rightNode.load(std::memory_order_acquire);
+            if (!node->m_lock.validate(pos.m_version)) return false;
+
+            LockPath path;
+            m_Node *succ{};
+            uint64_t succVersion{};
+            if (left && right) {
+                // walk to successor, every node between removed node and successor gets locked too,
+                // so readers which passed them restart instead of missing moved successor
+                OptimisticLock *parentLock = &node->m_lock;
+                uint64_t parentVersion = pos.m_version;
+                succ = right;
+                for (;;) {
+                    if (!succ->m_lock.readLock(succVersion) || !parentLock->validate(parentVersion)) return false;
+                    m_Node *next = succ->m_leftNode.load(std::memory_order_acquire);
+                    if (!next) break;
+                    path.push(succ, succVersion);
+                    parentLock = &succ->m_lock;
+                    parentVersion = succVersion;
+                    succ = next;
+                }
+            }
+
+            if (!pos.m_parentLock->upgrade(pos.m_parentVersion)) return false;
+            if (!node->m_lock.upgrade(pos.m_version)) {
+                pos.m_parentLock->unlock();
+                return false;
+            }
+            const size_t locked = path.lock();
+            if (locked != path.size() || (succ && !succ->m_lock.upgrade(succVersion))) {
+                path.unlock(locked);
+                node->m_lock.unlock();
+                pos.m_parentLock->unlock();
+                return false;
+            }
+
+            if (!succ) {
+                pos.m_link->store(left ? left : right, std::memory_order_release);
+            } else {
+                // lock-free readers below old place of successor could miss it, they turned right
+                // from removed node, which is locked now, and repeat when they see its version changed
+                if (path.size()) {
+                    path.back()->m_leftNode.store(succ->m_rightNode.load(std::memory_order_relaxed), std::memory_order_release);
+                    succ->m_rightNode.store(right, std::memory_order_release);
+                }
+                succ->m_leftNode.store(left, std::memory_order_release);
+                pos.m_link->store(succ, std::memory_order_release);
+                succ->m_lock.unlock();
+                path.unlock(path.size());
+            }
+            node->m_lock.unlockObsolete();
+            pos.m_parentLock->unlock();
+            m_numOfElements.fetch_sub(1, std::memory_order_relaxed);
+            EpochDomain::global().retire(node, &destroyRetired);
+            return true;
+        }
+
+        //! Creates node.
+
+        //! @param data Data forwarded to constructor of node.
+        //! @return Pointer to new node.
+        template<typename V>
+        m_Node *createNode(V &&data) {
+            m_Node *mem = m_allocator.allocate();
+            try {
+                return new (mem) m_Node(std::forward<V>(data));
+            } catch (...) {
+                m_allocator.deallocate(mem);
+                throw;
+            }
+        }
+
+        //! Destroys node.
+
+        //! @param node Node to destroy.
+        void destroyNode(m_Node *node) {
+            node->~m_Node();
+            m_allocator.deallocate(node);
+        }
+
+        //! Destroys node retired to epoch domain, heap allocator has no state so tree may not exist anymore.
+
+        //! @param object Retired node.
+        static void destroyRetired(EpochRetired *object) {
+            auto node = static_cast<m_Node *>(object);
+            node->~m_Node();
+            m_Allocator().deallocate(node);
+        }
+
+        std::atomic<m_Node *> m_rootNode{};   //!< Root of tree.
+        OptimisticLock m_rootLock;            //!< Lock guarding root pointer.
+        std::atomic<size_t> m_numOfElements{};//!< Number of elements.
+        m_Allocator m_allocator;              //!< Allocator of nodes.
+    };
+
+}// namespace simple
+#endif// CONCURRENTBST_H
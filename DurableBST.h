@@ -0,0 +1,628 @@
+/**
+ * @file DurableBST.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief template header file for binary search tree persisted by write-ahead log
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef DURABLEBST_H
+#define DURABLEBST_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "BST.h"
+
+namespace simple {
+    //! Durable binary search tree class.
+
+    //! Elements are kept in red-black BinarySearchTree, every insert and remove which changes it is also
+    //! appended to write-ahead log, so durable update costs I/O proportional to the change, not to size of tree.
+    //! Files are snapshot written by serialize() (fileName) and log (fileName.log). Records are written in
+    //! batches with checksum and every batch is synced to disk once (group commit): with groupSize 1 update
+    //! returns when it is durable, updates of other threads waiting at the same time share one sync,
+    //! with bigger groupSize update returns at once and log is written when groupSize updates are pending,
+    //! or by sync(). If writing of log fails, all updates which are not durable yet are undone, so tree stays
+    //! equal to content of log, and tree stops accepting updates (is_open() returns false).
+    //! Constructor recovers tree from snapshot and log, torn batch at end of log is cut off.
+    //! When log grows bigger than snapshot, compaction folds it into new snapshot in background thread:
+    //! log is renamed to fileName.log.old, new log is started and copy of tree is written to fileName.tmp,
+    //! which replaces snapshot, then old log is removed. Replay of log over snapshot which already contains
+    //! its changes gives the same tree, so crash at any point of compaction loses nothing.
+    //! All operations can be called by many threads at the same time.
+    template<typename T, typename Compare = std::less<T>>
+    class DurableBinarySearchTree {
+    public:
+        typedef BinarySearchTree<T, Compare, RedBlack> tree_type;
+        typedef Compare compare_type;
+
+        //! Constructor, opens snapshot and log and recovers tree from them.
+
+        //! Missing files are created. If log cannot be opened or belongs to other element type, is_open() returns false.
+        //! @param fileName Name of snapshot file, log is fileName.log.
+        //! @param groupSize Number of pending updates which are written and synced together, at least one.
+        //! @param comp Comparison criteria.
+        explicit DurableBinarySearchTree(const std::string &fileName, size_t groupSize = 1, const Compare &comp = Compare())
+            : m_tree(comp), m_fileName(fileName), m_logName(fileName + ".log"), m_oldLogName(fileName + ".log.old"),
+              m_groupSize(groupSize ? groupSize : 1) {
+            std::error_code error;
+            std::filesystem::remove(m_fileName + ".tmp", error);
+            m_tree.deserialize(m_fileName);
+            const auto snapshotSize = std::filesystem::file_size(m_fileName, error);
+            m_snapshotBytes = error ? 0 : static_cast<size_t>(snapshotSize);
+
+            // old log exists if compaction did not finish, it is older than log
+            m_rotated = std::filesystem::exists(m_oldLogName, error);
+            if (m_rotated && !replay(m_oldLogName)) return;
+            if (!replay(m_logName) || !openLog()) return;
+            m_open = true;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_rotated) startCompaction(lock);
+        }
+
+        //! Copy constructor, deleted.
+        DurableBinarySearchTree(const DurableBinarySearchTree &other) = delete;
+
+        //! Copy operator, deleted.
+        DurableBinarySearchTree &operator=(const DurableBinarySearchTree &other) = delete;
+
+        //! Destructor, writes pending updates and waits for compaction.
+        ~DurableBinarySearchTree() {
+            sync();
+            wait_compaction();
+            if (m_compactor.joinable()) m_compactor.join();
+            if (m_log) std::fclose(m_log);
+        }
+
+        //! Returns state of files.
+
+        //! @return False if files could not be opened or writing of log failed, tree does not accept updates then.
+        [[nodiscard]] bool is_open() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_open;
+        }
+
+        //! Inserts data to binary search tree and logs it.
+
+        //! @param data Data.
+        //! @return True if data was inserted and logged, false if equal data already exists or log failed,
+        //! tree is not changed then.
+        bool insert(const T &data) { return insertValue(data); }
+
+        //! Inserts data to binary search tree and logs it. (moves)
+
+        //! @param data Data.
+        //! @return True if data was inserted and logged, false if equal data already exists or log failed,
+        //! tree is not changed then.
+        bool insert(T &&data) { return insertValue(std::move(data)); }
+
+        //! Removes data from binary search tree and logs it.
+
+        //! @param data Data to remove.
+        //! @return True if data was removed and logged, false if it does not exist or log failed, tree is not changed then.
+        bool remove(const T &data) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_open) return false;
+            // log stored element, not the probe, they may only compare equal and undo has to restore the original
+            const T *stored = m_tree.search(data);
+            if (!stored) return false;
+            append(logRemove, *stored);
+            m_tree.remove(data);
+            return commit(lock);
+        }
+
+        //! Search for data.
+
+        //! @param data Data to search for.
+        //! @return True if equal data exists.
+        bool search(const T &data) const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_tree.search(data);
+        }
+
+        //! Search for data, copies found element.
+
+        //! @param data Data to search for.
+        //! @param result Set to copy of equal element if it exists.
+        //! @return True if equal data exists.
+        bool search(const T &data, T &result) const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const T *found = m_tree.search(data);
+            if (found) result = *found;
+            return found;
+        }
+
+        //! Calls function for every element, in order.
+
+        //! Tree is locked for the time of call, function must not modify it.
+        //! @param f Function called with const reference to element.
+        template<typename F>
+        void for_each(F f) const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto it = m_tree.begin(); it != m_tree.end(); ++it) f(*it);
+        }
+
+        //! Returns size of binary search tree.
+
+        //! @return Number of elements.
+        [[nodiscard]] size_t size() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_tree.size();
+        }
+
+        //! Returns size of log.
+
+        //! @return Number of bytes written to log since last compaction started.
+        [[nodiscard]] size_t log_size() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_logBytes;
+        }
+
+        //! Writes all pending updates to log and syncs it.
+
+        //! @return True if all updates are durable.
+        bool sync() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            return flush(lock, m_appended);
+        }
+
+        //! Starts compaction of log into new snapshot in background, if it does not run already.
+        void compact() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            startCompaction(lock);
+        }
+
+        //! Waits until running compaction finishes.
+        void wait_compaction() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return !m_compacting; });
+        }
+
+    private:
+        //! Growing byte buffer of log batch.
+        struct LogBuffer {
+            //! Appends bytes.
+
+            //! @param data Pointer to bytes.
+            //! @param size Number of bytes.
+            void append(const void *data, size_t size) {
+                reserve(m_size + size);
+                std::memcpy(m_data.get() + m_size, data, size);
+                m_size += size;
+            }
+
+            //! Makes place for given number of bytes, keeps content.
+
+            //! @param capacity Required capacity.
+            void reserve(size_t capacity) {
+                if (capacity <= m_capacity) return;
+                capacity = std::max({capacity, m_capacity * 2, size_t(4096)});
+                std::unique_ptr<char[]> data(new char[capacity]);
+                if (m_size) std::memcpy(data.get(), m_data.get(), m_size);
+                m_data = std::move(data);
+                m_capacity = capacity;
+            }
+
+            std::unique_ptr<char[]> m_data;//!< Bytes.
+            size_t m_size{};               //!< Number of used bytes.
+            size_t m_capacity{};           //!< Number of allocated bytes.
+        };
+
+        //! Header of batch of records in log.
+        struct BatchHeader {
+            uint64_t m_size;    //!< Number of bytes of records.
+            uint64_t m_count;   //!< Number of records.
+            uint64_t m_checksum;//!< FNV-1a hash of records.
+        };
+
+        static constexpr uint64_t logMagic = 0x31304c4157545342;//!< "BSTWAL01", starts log file.
+        static constexpr uint8_t logInsert = 1;                 //!< Record of inserted element.
+        static constexpr uint8_t logRemove = 2;                 //!< Record of removed element.
+        static constexpr size_t minCompactBytes = size_t(1) << 22;//!< Log smaller than this is never compacted automatically.
+
+        //! Size of element field in log header, 0 for elements written as strings.
+
+        //! @return Size of element.
+        static constexpr uint64_t elementSize() {
+            if constexpr (std::is_trivially_copyable_v<T>) return sizeof(T);
+            else return 0;
+        }
+
+        //! Inserts data and logs it.
+
+        //! @param data Data.
+        //! @return True if data was inserted and logged.
+        template<typename V>
+        bool insertValue(V &&data) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_open) return false;
+            const size_t before = m_tree.size();
+            const T &inserted = m_tree.insert(std::forward<V>(data));
+            if (m_tree.size() == before) return false;
+            append(logInsert, inserted);
+            return commit(lock);
+        }
+
+        //! Appends record to pending batch.
+
+        //! @param op Type of record.
+        //! @param data Element.
+        void append(uint8_t op, const T &data) {
+            m_pending.append(&op, 1);
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                m_pending.append(&data, sizeof(T));
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                appendString(data);
+            } else {
+                m_format.str(std::string());
+                m_format << data;
+                appendString(m_format.str());
+            }
+            ++m_pendingCount;
+            ++m_appended;
+        }
+
+        //! Appends length prefixed string to pending batch.
+
+        //! @param data String.
+        void appendString(const std::string &data) {
+            const uint64_t size = data.size();
+            m_pending.append(&size, sizeof(size));
+            m_pending.append(data.data(), data.size());
+        }
+
+        //! Writes pending batch if group is full, starts compaction if log is big.
+
+        //! @param lock Lock of tree.
+        //! @return False if log failed.
+        bool commit(std::unique_lock<std::mutex> &lock) {
+            if (m_pendingCount < m_groupSize) return true;
+            const bool written = flush(lock, m_appended);
+            if (written && m_logBytes >= std::max(minCompactBytes, m_snapshotBytes)) startCompaction(lock);
+            return written;
+        }
+
+        //! Waits until record with given number is durable.
+
+        //! Thread which finds log idle becomes leader, takes all pending records and writes them
+        //! as one batch with lock released, others wait and their records go in the same or next batch.
+        //! If batch cannot be written, it and all pending records are undone and log is closed.
+        //! @param lock Lock of tree.
+        //! @param ticket Number of record.
+        //! @return False if log failed.
+        bool flush(std::unique_lock<std::mutex> &lock, uint64_t ticket) {
+            while (m_open && m_durable < ticket) {
+                if (m_flushing) {
+                    m_done.wait(lock);
+                    continue;
+                }
+                m_flushing = true;
+                std::swap(m_pending, m_writing);
+                const uint64_t count = m_pendingCount, last = m_appended;
+                m_pending.m_size = 0;
+                m_pendingCount = 0;
+
+                lock.unlock();
+                const bool written = writeBatch(m_writing, count);
+                lock.lock();
+
+                m_flushing = false;
+                if (written) {
+                    m_durable = last;
+                    m_logBytes += sizeof(BatchHeader) + m_writing.m_size;
+                } else {
+                    // records appended meanwhile are newer than batch, they are undone first
+                    undo(m_pending, m_pendingCount);
+                    undo(m_writing, count);
+                    m_pending.m_size = 0;
+                    m_pendingCount = 0;
+                    m_open = false;
+                }
+                m_done.notify_all();
+            }
+            return m_open;
+        }
+
+        //! Writes batch to log and syncs it.
+
+        //! @param batch Records.
+        //! @param count Number of records.
+        //! @return True if batch is durable.
+        bool writeBatch(const LogBuffer &batch, uint64_t count) {
+            const BatchHeader header{batch.m_size, count, checksum(batch.m_data.get(), batch.m_size)};
+            return std::fwrite(&header, sizeof(header), 1, m_log) == 1 &&
+                   std::fwrite(batch.m_data.get(), 1, batch.m_size, m_log) == batch.m_size && syncFile(m_log);
+        }
+
+        //! Starts compaction in background thread, if it does not run already.
+
+        //! Pending records are written first, log is renamed to old log unless old log is still there from
+        //! compaction which failed, then copy of tree is taken, which costs only memory bandwidth under lock.
+        //! @param lock Lock of tree.
+        void startCompaction(std::unique_lock<std::mutex> &lock) {
+            while (m_open && !m_compacting && (m_flushing || m_pendingCount)) {
+                if (m_flushing)
+                    m_done.wait(lock);
+                else
+                    flush(lock, m_appended);
+            }
+            if (!m_open || m_compacting) return;
+
+            if (!m_rotated) {
+                std::fclose(m_log);
+                m_log = nullptr;
+                std::error_code error;
+                std::filesystem::rename(m_logName, m_oldLogName, error);
+                m_rotated = !error;
+                if (!openLog()) {
+                    m_open = false;
+                    return;
+                }
+            }
+
+            auto copy = std::make_unique<tree_type>(m_tree);
+            m_compacting = true;
+            if (m_compactor.joinable()) m_compactor.join();
+            m_compactor = std::thread([this, copy = std::move(copy)]() mutable {
+                size_t bytes{};
+                const bool written = writeSnapshot(*copy, bytes);
+                copy.reset();
+                std::error_code error;
+                if (written) std::filesystem::remove(m_oldLogName, error);
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (written) {
+                    m_rotated = false;
+                    m_snapshotBytes = bytes;
+                }
+                m_compacting = false;
+                m_done.notify_all();
+            });
+        }
+
+        //! Writes tree to temporary file, syncs it and renames it to snapshot.
+
+        //! @param tree Tree to write.
+        //! @param bytes Set to size of snapshot.
+        //! @return True if snapshot was replaced.
+        bool writeSnapshot(const tree_type &tree, size_t &bytes) {
+            const std::string tmpName = m_fileName + ".tmp";
+            std::FILE *file = std::fopen(tmpName.c_str(), "wb");
+            if (!file) return false;
+            bool written = true;
+            tree.serialize([&](const char *data, size_t size) {
+                written = written && std::fwrite(data, 1, size, file) == size;
+                bytes += size;
+            });
+            written = syncFile(file) && written;
+            written = std::fclose(file) == 0 && written;
+            std::error_code error;
+            if (written) std::filesystem::rename(tmpName, m_fileName, error);
+            if (!written || error) {
+                std::filesystem::remove(tmpName, error);
+                return false;
+            }
+            syncDirectory();
+            return true;
+        }
+
+        //! Opens log for appending, new log gets header.
+
+        //! @return True if log is open.
+        bool openLog() {
+            std::error_code error;
+            const auto size = std::filesystem::file_size(m_logName, error);
+            m_log = std::fopen(m_logName.c_str(), "ab");
+            if (!m_log) return false;
+            if (!error && size) {
+                m_logBytes = static_cast<size_t>(size);
+                return true;
+            }
+            const uint64_t header[2] = {logMagic, elementSize()};
+            if (std::fwrite(header, sizeof(header), 1, m_log) != 1 || !syncFile(m_log)) return false;
+            syncDirectory();
+            m_logBytes = sizeof(header);
+            return true;
+        }
+
+        //! Applies records of log to tree, torn or damaged batch at end of log is cut off.
+
+        //! @param name Name of log file.
+        //! @return False if log belongs to other element type.
+        bool replay(const std::string &name) {
+            std::error_code error;
+            const auto fileSize = std::filesystem::file_size(name, error);
+            if (error) return true;
+            std::ifstream in(name, std::ios::in | std::ios::binary);
+            uint64_t header[2]{};
+            uint64_t good{};
+            if (in.read(reinterpret_cast<char *>(header), sizeof(header))) {
+                if (header[0] != logMagic || header[1] != elementSize()) return false;
+                good = sizeof(header);
+                LogBuffer batch;
+                BatchHeader batchHeader{};
+                while (in.read(reinterpret_cast<char *>(&batchHeader), sizeof(batchHeader)) &&
+                       batchHeader.m_size <= fileSize - good - sizeof(batchHeader)) {
+                    batch.reserve(static_cast<size_t>(batchHeader.m_size));
+                    batch.m_size = static_cast<size_t>(batchHeader.m_size);
+                    if (!in.read(batch.m_data.get(), static_cast<std::streamsize>(batch.m_size)) ||
+                        checksum(batch.m_data.get(), batch.m_size) != batchHeader.m_checksum || !apply(batch, batchHeader.m_count))
+                        break;
+                    good += sizeof(batchHeader) + batch.m_size;
+                }
+            }
+            in.close();
+            if (good < fileSize) std::filesystem::resize_file(name, good, error);
+            return true;
+        }
+
+        //! Applies records of batch to tree.
+
+        //! @param batch Records.
+        //! @param count Number of records.
+        //! @return False if batch is damaged, records before damage stay applied.
+        bool apply(const LogBuffer &batch, uint64_t count) {
+            const char *pos = batch.m_data.get(), *end = pos + batch.m_size;
+            for (uint64_t i = 0; i < count; ++i)
+                if (!decode(pos, end, [this](uint8_t op, auto &&data) { applyRecord(op, std::forward<decltype(data)>(data)); }))
+                    return false;
+            return pos == end;
+        }
+
+        //! Undoes records of batch which was not written, in reverse order.
+
+        //! Every record changed tree, so inserted element is removed and removed element inserted again.
+        //! @param batch Records.
+        //! @param count Number of records.
+        void undo(const LogBuffer &batch, uint64_t count) {
+            if (!count) return;
+            std::unique_ptr<const char *[]> records(new const char *[count]);
+            const char *pos = batch.m_data.get(), *end = pos + batch.m_size;
+            for (uint64_t i = 0; i < count; ++i) {
+                records[i] = pos;
+                decode(pos, end, [](uint8_t, auto &&) {});
+            }
+            for (uint64_t i = count; i--;) {
+                pos = records[i];
+                decode(pos, end, [this](uint8_t op, auto &&data) {
+                    applyRecord(op == logInsert ? logRemove : logInsert, std::forward<decltype(data)>(data));
+                });
+            }
+        }
+
+        //! Decodes one record.
+
+        //! @param pos Position of record, moved past it.
+        //! @param end End of batch.
+        //! @param f Function called with type of record and element.
+        //! @return False if record is damaged.
+        template<typename F>
+        bool decode(const char *&pos, const char *end, F f) {
+            if (pos == end) return false;
+            const uint8_t op = static_cast<uint8_t>(*pos++);
+            if (op != logInsert && op != logRemove) return false;
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                if (static_cast<size_t>(end - pos) < sizeof(T)) return false;
+                std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+                std::memcpy(&storage, pos, sizeof(T));
+                pos += sizeof(T);
+                f(op, *std::launder(reinterpret_cast<const T *>(&storage)));
+            } else {
+                uint64_t size;
+                if (static_cast<size_t>(end - pos) < sizeof(size)) return false;
+                std::memcpy(&size, pos, sizeof(size));
+                pos += sizeof(size);
+                if (static_cast<uint64_t>(end - pos) < size) return false;
+                std::string data(pos, static_cast<size_t>(size));
+                pos += size;
+                if constexpr (std::is_same_v<T, std::string>) {
+                    f(op, std::move(data));
+                } else {
+                    T tmp;
+                    m_parse.clear();
+                    m_parse.str(data);
+                    m_parse >> tmp;
+                    f(op, std::move(tmp));
+                }
+            }
+            return true;
+        }
+
+        //! Applies one record to tree.
+
+        //! @param op Type of record.
+        //! @param data Element.
+        template<typename V>
+        void applyRecord(uint8_t op, V &&data) {
+            if (op == logInsert)
+                m_tree.insert(std::forward<V>(data));
+            else
+                m_tree.remove(data);
+        }
+
+        //! FNV-1a hash of bytes.
+
+        //! @param data Pointer to bytes.
+        //! @param size Number of bytes.
+        //! @return Hash.
+        static uint64_t checksum(const char *data, size_t size) {
+            uint64_t hash = 0xcbf29ce484222325;
+            for (size_t i = 0; i < size; ++i) hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3;
+            return hash;
+        }
+
+        //! Flushes file and syncs it to disk.
+
+        //! @param file File.
+        //! @return True on success.
+        static bool syncFile(std::FILE *file) {
+            if (std::fflush(file)) return false;
+#if defined(_WIN32)
+            return _commit(_fileno(file)) == 0;
+#else
+            return fsync(fileno(file)) == 0;
+#endif
+        }
+
+        //! Syncs directory of snapshot, so created and renamed files stay after crash.
+        void syncDirectory() const {
+#if !defined(_WIN32)
+            std::filesystem::path directory = std::filesystem::path(m_fileName).parent_path();
+            if (directory.empty()) directory = ".";
+            const int fd = open(directory.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            fsync(fd);
+            close(fd);
+#endif
+        }
+
+        tree_type m_tree;                 //!< Elements.
+        const std::string m_fileName;     //!< Name of snapshot.
+        const std::string m_logName;      //!< Name of log.
+        const std::string m_oldLogName;   //!< Name of log being compacted.
+        const size_t m_groupSize;         //!< Number of pending records which are written together.
+        std::FILE *m_log{};               //!< Log opened for appending.
+        bool m_open{};                    //!< False if files could not be opened or log failed.
+        bool m_flushing{};                //!< True while some thread writes batch.
+        bool m_compacting{};              //!< True while compaction runs.
+        bool m_rotated{};                 //!< True if old log exists.
+        LogBuffer m_pending;              //!< Records waiting for next batch.
+        LogBuffer m_writing;              //!< Batch being written.
+        uint64_t m_pendingCount{};        //!< Number of records in pending batch.
+        uint64_t m_appended{};            //!< Number of appended records.
+        uint64_t m_durable{};             //!< Number of records synced to log.
+        size_t m_logBytes{};              //!< Size of log.
+        size_t m_snapshotBytes{};         //!< Size of last snapshot.
+        std::ostringstream m_format;      //!< Stream formatting elements which are not strings.
+        std::istringstream m_parse;       //!< Stream parsing elements which are not strings.
+        mutable std::mutex m_mutex;       //!< Lock guarding tree and log state.
+        std::condition_variable m_done;   //!< Signals finished batch or compaction.
+        std::thread m_compactor;          //!< Compaction thread.
+    };
+
+}// namespace simple
+#endif// DURABLEBST_H
@@ -0,0 +1,214 @@
+/**
+ * @file Epoch.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief epoch-based memory reclamation used by concurrent binary search tree
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace simple {
+    //! Base of objects which can be retired to epoch domain.
+    struct EpochRetired {
+        EpochRetired *m_nextRetired{};          //!< Next retired object of the same thread.
+        uint64_t m_retireEpoch{};               //!< Global epoch when object was retired.
+        void (*m_deleter)(EpochRetired *){};    //!< Function destroying object.
+    };
+
+    //! Epoch-based memory reclamation.
+
+    //! Threads reading shared objects enter critical section with EpochGuard, which announces
+    //! current global epoch with one store and one fence, no read-modify-write is done.
+    //! Object removed from shared structure is retired, it is destroyed after global epoch
+    //! advanced twice, then no thread can still be reading it. Epoch advances only when all threads
+    //! in critical sections announced current epoch. Every thread keeps its own list of retired objects.
+    class EpochDomain {
+    public:
+        //! Returns domain shared by all concurrent structures, the only one.
+
+        //! @return Global domain.
+        static EpochDomain &global() {
+            static EpochDomain domain;
+            return domain;
+        }
+
+        //! Retires object removed from shared structure, it is destroyed when nobody can read it.
+
+        //! @param object Object to retire, it has to be unreachable for threads which enter critical section later.
+        //! @param deleter Function destroying object.
+        void retire(EpochRetired *object, void (*deleter)(EpochRetired *)) {
+            Record &rec = record();
+            object->m_deleter = deleter;
+            // object was unlinked before, nobody entering critical section after this epoch can reach it
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            object->m_retireEpoch = m_epoch.load(std::memory_order_seq_cst);
+            object->m_nextRetired = rec.m_retired;
+            rec.m_retired = object;
+            if (++rec.m_retiredCount >= reclaimThreshold) reclaim(rec);
+        }
+
+        //! Tries to advance epoch and destroys retired objects of calling thread which are safe to destroy.
+        void reclaim() { reclaim(record()); }
+
+    private:
+        friend class EpochGuard;
+
+        //! State of one thread, records are never freed, record of finished thread is reused.
+        struct Record {
+            std::atomic<uint64_t> m_epoch{};   //!< Announced epoch, 0 outside of critical section.
+            std::atomic<bool> m_used{};        //!< True if record belongs to a thread.
+            Record *m_next{};                  //!< Next record.
+            unsigned m_nesting{};              //!< Depth of nested critical sections.
+            EpochRetired *m_retired{};         //!< Retired objects, newest first.
+            size_t m_retiredCount{};           //!< Number of retired objects.
+        };
+
+        //! Releases record when thread finishes, its retired objects stay for next owner.
+        struct RecordOwner {
+            //! Destructor, frees record for other threads.
+            ~RecordOwner() {
+                if (m_record) m_record->m_used.store(false, std::memory_order_release);
+            }
+
+            Record *m_record{};//!< Record of thread.
+        };
+
+        //! Default constructor.
+        EpochDomain() = default;
+
+        //! Destructor, destroys all retired objects, no thread can use domain anymore.
+        ~EpochDomain() {
+            Record *rec = m_records.load(std::memory_order_acquire);
+            while (rec) {
+                Record *next = rec->m_next;
+                destroy(rec->m_retired);
+                delete rec;
+                rec = next;
+            }
+        }
+
+        //! Returns record of calling thread, takes free record or adds new one at first use.
+
+        //! @return Record of thread.
+        Record &record() {
+            static thread_local RecordOwner owner;
+            if (owner.m_record) return *owner.m_record;
+            for (Record *rec = m_records.load(std::memory_order_acquire); rec; rec = rec->m_next) {
+                bool used = false;
+                if (!rec->m_used.load(std::memory_order_relaxed) && rec->m_used.compare_exchange_strong(used, true, std::memory_order_acquire)) {
+                    owner.m_record = rec;
+                    return *rec;
+                }
+            }
+            auto rec = new Record;
+            rec->m_used.store(true, std::memory_order_relaxed);
+            rec->m_next = m_records.load(std::memory_order_relaxed);
+            while (!m_records.compare_exchange_weak(rec->m_next, rec, std::memory_order_release, std::memory_order_relaxed)) {}
+            owner.m_record = rec;
+            return *rec;
+        }
+
+        //! Enters critical section.
+
+        //! @param rec Record of calling thread.
+        void enter(Record &rec) {
+            if (rec.m_nesting++) return;
+            rec.m_epoch.store(m_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            // announcement has to be visible before any shared object is read
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        //! Leaves critical section.
+
+        //! @param rec Record of calling thread.
+        void leave(Record &rec) {
+            if (--rec.m_nesting) return;
+            rec.m_epoch.store(0, std::memory_order_release);
+        }
+
+        //! Advances epoch if possible and destroys retired objects which are safe to destroy.
+
+        //! @param rec Record of calling thread.
+        void reclaim(Record &rec) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+            bool advance = true;
+            for (Record *tmp = m_records.load(std::memory_order_acquire); tmp && advance; tmp = tmp->m_next) {
+                uint64_t announced = tmp->m_epoch.load(std::memory_order_seq_cst);
+                advance = !announced || announced == epoch;
+            }
+            if (advance && m_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst)) ++epoch;
+
+            // objects retired two epochs ago cannot be reached by anybody
+            EpochRetired **link = &rec.m_retired;
+            EpochRetired *safe = nullptr;
+            while (*link) {
+                if ((*link)->m_retireEpoch + 2 <= epoch) {
+                    safe = *link;
+                    *link = nullptr;
+                    break;
+                }
+                link = &(*link)->m_nextRetired;
+            }
+            rec.m_retiredCount -= destroy(safe);
+        }
+
+        //! Destroys list of retired objects.
+
+        //! @param object First object of list.
+        //! @return Number of destroyed objects.
+        static size_t destroy(EpochRetired *object) {
+            size_t count{};
+            while (object) {
+                EpochRetired *next = object->m_nextRetired;
+                object->m_deleter(object);
+                object = next;
+                ++count;
+            }
+            return count;
+        }
+
+        static constexpr size_t reclaimThreshold = 128;//!< Number of retired objects which triggers reclamation.
+
+        std::atomic<uint64_t> m_epoch{1};      //!< Global epoch, announced epochs are never 0.
+        std::atomic<Record *> m_records{};     //!< List of thread records.
+    };
+
+    //! Critical section of epoch domain.
+
+    //! Objects read inside of critical section are not destroyed until it ends.
+    //! Guard has to be used and destroyed by thread which created it, sections can be nested.
+    class EpochGuard {
+    public:
+        //! Constructor, enters critical section of global domain.
+        EpochGuard() : m_record(&EpochDomain::global().record()) { EpochDomain::global().enter(*m_record); }
+
+        //! Copy constructor, enters nested critical section.
+
+        //! @param other Guard to copy.
+        EpochGuard(const EpochGuard &other) : m_record(other.m_record) { EpochDomain::global().enter(*m_record); }
+
+        //! Copy operator.
+
+        //! Both guards are in critical section already, so nothing changes.
+        //! @param other Guard to copy.
+        //! @return Guard.
+        EpochGuard &operator=(const EpochGuard & /*other*/) { return *this; }
+
+        //! Destructor, leaves critical section.
+        ~EpochGuard() { EpochDomain::global().leave(*m_record); }
+
+    private:
+        EpochDomain::Record *m_record;//!< Record of thread which owns guard.
+    };
+
+}// namespace simple
+#endif// EPOCH_H
@@ -0,0 +1,425 @@
+/**
+ * @file FrozenBST.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief template header file for read-only binary search tree memory-mapped from file
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef FROZENBST_H
+#define FROZENBST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(_WIN32)
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace simple {
+    //! Header of frozen tree file.
+
+    //! Records follow at recordsOffset, record 0 is unused and record i has children 2i and 2i + 1
+    //! (Eytzinger layout of complete binary search tree). Strings are kept in heap at heapOffset,
+    //! in sorted order. All numbers are in native byte order.
+    struct FrozenHeader {
+        uint64_t m_magic;        //!< Always frozenMagic.
+        uint64_t m_recordSize;   //!< Size of one record.
+        uint64_t m_count;        //!< Number of elements.
+        uint64_t m_recordsOffset;//!< Offset of record 0 in file.
+        uint64_t m_heapOffset;   //!< Offset of string heap in file.
+        uint64_t m_heapSize;     //!< Size of string heap.
+    };
+
+    inline constexpr uint64_t frozenMagic = 0x31305a5246545342;//!< "BSTFRZ01", starts frozen tree file.
+    inline constexpr uint64_t frozenAlignment = 64;            //!< Alignment of records in file, one cache line.
+
+    //! Record of string in frozen file.
+    struct FrozenString {
+        uint64_t m_offset;//!< Offset of string in heap.
+        uint64_t m_size;  //!< Length of string.
+    };
+
+    //! Mapping of element type to record in frozen file, trivially copyable types are stored directly.
+    template<typename T>
+    struct FrozenTraits {
+        static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable types and std::string can be frozen");
+
+        typedef T record_type;   //!< Type stored in file.
+        typedef T key_type;      //!< Type of searched keys.
+        typedef const T &reference;//!< Type returned by iterator.
+
+        //! Returns element of record.
+
+        //! @param record Record in file.
+        //! @param heap String heap, unused.
+        //! @return Reference to element in file.
+        static reference get(const record_type &record, const char * /*heap*/) { return record; }
+    };
+
+    //! Mapping of std::string to record with offset to string heap.
+    template<>
+    struct FrozenTraits<std::string> {
+        typedef FrozenString record_type;   //!< Type stored in file.
+        typedef std::string_view key_type;  //!< Type of searched keys.
+        typedef std::string_view reference; //!< Type returned by iterator.
+
+        //! Returns element of record.
+
+        //! @param record Record in file.
+        //! @param heap String heap.
+        //! @return View of string in file.
+        static reference get(const record_type &record, const char *heap) { return {heap + record.m_offset, record.m_size}; }
+    };
+
+    //! Returns index of the smallest element in Eytzinger layout.
+
+    //! @param count Number of elements.
+    //! @return Index, 0 if there are no elements.
+    inline size_t eytzingerFirst(size_t count) {
+        size_t i = count ? 1 : 0;
+        while (i && 2 * i <= count) i *= 2;
+        return i;
+    }
+
+    //! Returns index of next element in order in Eytzinger layout.
+
+    //! @param i Index of element.
+    //! @param count Number of elements.
+    //! @return Index of successor, 0 after the greatest element.
+    inline size_t eytzingerNext(size_t i, size_t count) {
+        if (2 * i + 1 <= count) {
+            i = 2 * i + 1;
+            while (2 * i <= count) i *= 2;
+            return i;
+        }
+        // go up while coming from right child
+        while (i & 1) i >>= 1;
+        return i >> 1;
+    }
+
+    //! Writes frozen tree file.
+
+    //! @param fileName Name of file.
+    //! @param first Iterator to the smallest element, elements have to be sorted without duplicates.
+    //! @param count Number of elements.
+    //! @return True if file was written.
+    template<typename T, typename ForwardIt>
+    bool writeFrozen(const std::string &fileName, ForwardIt first, size_t count) {
+        typedef FrozenTraits<T> Traits;
+        typedef typename Traits::record_type Record;
+        std::ofstream oFile(fileName, std::ios::out | std::ios::binary);
+        if (!oFile) return false;
+
+        // records are placed in order of in-order walk of implicit tree
+        std::unique_ptr<char[]> records(new char[(count + 1) * sizeof(Record)]());
+        uint64_t heapSize{};
+        ForwardIt it = first;
+        for (size_t i = eytzingerFirst(count); i; i = eytzingerNext(i, count), ++it) {
+            if constexpr (std::is_same_v<T, std::string>) {
+                const FrozenString record{heapSize, it->size()};
+                std::memcpy(records.get() + i * sizeof(Record), &record, sizeof(Record));
+                heapSize += it->size();
+            } else {
+                std::memcpy(records.get() + i * sizeof(Record), &*it, sizeof(Record));
+            }
+        }
+
+        FrozenHeader header{frozenMagic, sizeof(Record), count, 0, 0, heapSize};
+        header.m_recordsOffset = (sizeof(FrozenHeader) + frozenAlignment - 1) / frozenAlignment * frozenAlignment;
+        header.m_heapOffset = header.m_recordsOffset + (count + 1) * sizeof(Record);
+        const char padding[frozenAlignment]{};
+        oFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        oFile.write(padding, static_cast<std::streamsize>(header.m_recordsOffset - sizeof(header)));
+        oFile.write(records.get(), static_cast<std::streamsize>((count + 1) * sizeof(Record)));
+        if constexpr (std::is_same_v<T, std::string>) {
+            // second pass writes strings in sorted order, as offsets were given
+            for (size_t i = 0; i < count; ++i, ++first) oFile.write(first->data(), static_cast<std::streamsize>(first->size()));
+        }
+        return static_cast<bool>(oFile);
+    }
+
+    //! Frozen binary search tree class.
+
+    //! Read-only binary search tree which is mapped from file written by BinarySearchTree::freeze_to() and queried
+    //! in place, opening it does no parsing and no allocation per element. Elements are stored in Eytzinger layout,
+    //! so search touches records from top of implicit tree which stay in cache. Strings are returned as std::string_view
+    //! into mapped file. Compare has to accept key_type and order elements the same way as tree which wrote the file,
+    //! transparent std::less<> is used by default. File is trusted, only its header is checked.
+    template<typename T, typename Compare = std::less<>>
+    class FrozenBinarySearchTree {
+    private:
+        typedef FrozenTraits<T> m_Traits;
+        typedef typename m_Traits::record_type m_Record;
+
+    public:
+        typedef typename m_Traits::key_type key_type;
+        typedef typename m_Traits::reference reference;
+        typedef Compare compare_type;
+
+        //! Frozen binary search tree forward iterator class, in order.
+        class iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef key_type value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const key_type *pointer;
+            typedef FrozenBinarySearchTree::reference reference;
+
+            //! Default constructor.
+            iterator() = default;
+
+            //! Dereference operator.
+
+            //! @return Element.
+            reference operator*() const { return m_tree->get(m_index); }
+
+            //! Pre-incrementation operator.
+
+            //! @return New iterator.
+            iterator &operator++() {
+                m_index = eytzingerNext(m_index, m_tree->size());
+                return *this;
+            }
+
+            //! Post-incrementation operator.
+
+            //! @return Iterator before incrementation.
+            iterator operator++(int) {
+                iterator tmp(*this);
+                ++*this;
+                return tmp;
+            }
+
+            //! Compare operator.
+
+            //! @param other Iterator to compare with.
+            //! @return True if both iterators point at the same element.
+            bool operator==(const iterator &other) const { return m_index == other.m_index; }
+
+            //! Difference operator.
+
+            //! @param other Iterator to compare with.
+            //! @return True if iterators point at different elements.
+            bool operator!=(const iterator &other) const { return m_index != other.m_index; }
+
+        private:
+            friend class FrozenBinarySearchTree;
+
+            //! Constructor used by tree.
+
+            //! @param tree Tree.
+            //! @param index Index of element, 0 for end.
+            iterator(const FrozenBinarySearchTree *tree, size_t index) : m_tree(tree), m_index(index) {}
+
+            const FrozenBinarySearchTree *m_tree{};//!< Tree.
+            size_t m_index{};                      //!< Index of element in Eytzinger layout, 0 for end.
+        };
+
+        //! Constructor, maps file.
+
+        //! If file cannot be mapped or its header is wrong tree is empty and is_open() returns false.
+        //! @param fileName Name of file written by freeze_to().
+        //! @param comp Comparison criteria.
+        explicit FrozenBinarySearchTree(const std::string &fileName, const Compare &comp = Compare()) : m_comp(comp) {
+            map(fileName);
+            if (!m_data) return;
+            const auto *header = reinterpret_cast<const FrozenHeader *>(m_data);
+            const bool valid = m_size >= sizeof(FrozenHeader) && header->m_magic == frozenMagic && header->m_recordSize == sizeof(m_Record) &&
+                               header->m_recordsOffset % alignof(m_Record) == 0 && header->m_recordsOffset <= m_size &&
+                               (m_size - header->m_recordsOffset) / sizeof(m_Record) > header->m_count &&
+                               header->m_heapOffset <= m_size && m_size - header->m_heapOffset >= header->m_heapSize;
+            if (!valid) {
+                unmap();
+                return;
+            }
+            m_count = static_cast<size_t>(header->m_count);
+            m_records = reinterpret_cast<const m_Record *>(m_data + header->m_recordsOffset);
+            m_heap = m_data + header->m_heapOffset;
+        }
+
+        //! Copy constructor, deleted.
+        FrozenBinarySearchTree(const FrozenBinarySearchTree &other) = delete;
+
+        //! Copy operator, deleted.
+        FrozenBinarySearchTree &operator=(const FrozenBinarySearchTree &other) = delete;
+
+        //! Move constructor.
+
+        //! @param other Tree to take mapping from, it becomes empty.
+        FrozenBinarySearchTree(FrozenBinarySearchTree &&other) noexcept
+            : m_comp(other.m_comp), m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)),
+              m_count(std::exchange(other.m_count, 0)), m_records(std::exchange(other.m_records, nullptr)), m_heap(std::exchange(other.m_heap, nullptr)) {
+#if defined(_WIN32)
+            m_buffer = std::move(other.m_buffer);
+#endif
+        }
+
+        //! Move operator.
+
+        //! @param other Tree to take mapping from, it becomes empty.
+        //! @return Tree.
+        FrozenBinarySearchTree &operator=(FrozenBinarySearchTree &&other) noexcept {
+            if (this != &other) {
+                unmap();
+                m_comp = other.m_comp;
+                m_data = std::exchange(other.m_data, nullptr);
+                m_size = std::exchange(other.m_size, 0);
+                m_count = std::exchange(other.m_count, 0);
+                m_records = std::exchange(other.m_records, nullptr);
+                m_heap = std::exchange(other.m_heap, nullptr);
+#if defined(_WIN32)
+                m_buffer = std::move(other.m_buffer);
+#endif
+            }
+            return *this;
+        }
+
+        //! Destructor, unmaps file.
+        ~FrozenBinarySearchTree() { unmap(); }
+
+        //! Checks if file was mapped.
+
+        //! @return True if file was mapped and has correct header.
+        [[nodiscard]] bool is_open() const { return m_data; }
+
+        //! Returns size of binary search tree.
+
+        //! @return Number of elements.
+        [[nodiscard]] size_t size() const { return m_count; }
+
+        //! Search for data.
+
+        //! @param data Data to search for.
+        //! @return True if equal element exists.
+        bool search(const key_type &data) const { return find(data) != end(); }
+
+        //! Finds element equal to data, O(log n).
+
+        //! @param data Data to search for.
+        //! @return Iterator to found element or end iterator.
+        iterator find(const key_type &data) const {
+            iterator it = lower_bound(data);
+            return it != end() && !m_comp(data, *it) ? it : end();
+        }
+
+        //! Iterator to first element not less than data, O(log n).
+
+        //! @param data Data to compare with.
+        //! @return Iterator to found element or end iterator.
+        iterator lower_bound(const key_type &data) const {
+            return bound([&](reference e) { return m_comp(e, data); });
+        }
+
+        //! Iterator to first element greater than data, O(log n).
+
+        //! @param data Data to compare with.
+        //! @return Iterator to found element or end iterator.
+        iterator upper_bound(const key_type &data) const {
+            return bound([&](reference e) { return !m_comp(data, e); });
+        }
+
+        //! Iterator to min element.
+
+        //! @return begin iterator.
+        iterator begin() const { return iterator(this, eytzingerFirst(m_count)); }
+
+        //! Iterator to end.
+
+        //! @return end iterator.
+        iterator end() const { return iterator(this, 0); }
+
+    private:
+        //! Returns element.
+
+        //! @param index Index of element in Eytzinger layout.
+        //! @return Element.
+        reference get(size_t index) const { return m_Traits::get(m_records[index], m_heap); }
+
+        //! Finds first element for which predicate is false, predicate has to be true then false in order.
+
+        //! Walks down implicit tree without branches, then climbs up to the last node where walk went left.
+        //! @param goRight Predicate, true if element is before searched one.
+        //! @return Iterator to found element or end iterator.
+        template<typename Pred>
+        iterator bound(Pred goRight) const {
+            size_t i = 1;
+            while (i <= m_count) i = 2 * i + static_cast<size_t>(goRight(get(i)));
+            while (i & 1) i >>= 1;
+            return iterator(this, i >> 1);
+        }
+
+        //! Maps file to memory.
+
+        //! @param fileName Name of file.
+        void map(const std::string &fileName) {
+#if defined(_WIN32)
+            std::ifstream iFile(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+            if (!iFile) return;
+            m_size = static_cast<size_t>(iFile.tellg());
+            m_buffer.reset(new Chunk[m_size / sizeof(Chunk) + 1]);
+            iFile.seekg(0);
+            if (!iFile.read(reinterpret_cast<char *>(m_buffer.get()), static_cast<std::streamsize>(m_size))) return;
+            m_data = reinterpret_cast<const char *>(m_buffer.get());
+#else
+            const int fd = ::open(fileName.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat st {};
+            if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                void *ptr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+                if (ptr != MAP_FAILED) {
+                    m_data = static_cast<const char *>(ptr);
+                    m_size = static_cast<size_t>(st.st_size);
+                }
+            }
+            ::close(fd);
+#endif
+        }
+
+        //! Unmaps file.
+        void unmap() {
+#if defined(_WIN32)
+            m_buffer.reset();
+#else
+            if (m_data) ::munmap(const_cast<char *>(m_data), m_size);
+#endif
+            m_data = nullptr;
+            m_size = 0;
+            m_count = 0;
+            m_records = nullptr;
+            m_heap = nullptr;
+        }
+
+        Compare m_comp;                //!< Comparison criteria.
+        const char *m_data{};          //!< Mapped file.
+        size_t m_size{};               //!< Size of mapped file.
+        size_t m_count{};              //!< Number of elements.
+        const m_Record *m_records{};   //!< Records, record 0 is unused.
+        const char *m_heap{};          //!< String heap.
+#if defined(_WIN32)
+        //! Aligned block of file content.
+        struct alignas(frozenAlignment) Chunk {
+            char m_bytes[frozenAlignment];//!< Bytes.
+        };
+
+        std::unique_ptr<Chunk[]> m_buffer;//!< File content, read at once where mmap is not available.
+#endif
+    };
+
+}// namespace simple
+#endif// FROZENBST_H
@@ -0,0 +1,274 @@
+/**
+ * @file MapBST.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief template header file for key-value map built on binary search tree nodes
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef MAPBST_H
+#define MAPBST_H
+
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <utility>
+
+#include "BST.h"
+
+namespace simple {
+    //! Comparison criteria of map elements.
+
+    //! Compares key - value pairs by keys only, with key comparison criteria.
+    template<typename K, typename V, typename Compare>
+    class MapKeyCompare : private CompareStorage<Compare> {
+    public:
+        //! Constructor.
+
+        //! @param comp Comparison criteria of keys.
+        MapKeyCompare(const Compare &comp = Compare()) : CompareStorage<Compare>(comp) {}
+
+        //! Compares keys of two elements.
+
+        //! @param a First element.
+        //! @param b Second element.
+        //! @return True if key of a is less than key of b.
+        bool operator()(const std::pair<const K, V> &a, const std::pair<const K, V> &b) const {
+            return this->comparator()(a.first, b.first);
+        }
+
+        //! Returns comparison criteria of keys.
+
+        //! @return Reference to comparator.
+        const Compare &key_comp() const { return this->comparator(); }
+    };
+
+    //! Binary search map class.
+
+    //! Stores key - value pairs in nodes of BinarySearchTree ordered by keys, values can be modified in place.
+    //! try_emplace(), insert_or_assign(), operator[], find() and remove() walk down from root once,
+    //! comparing only keys, and construct nothing if key already exists. New node is built directly
+    //! from key and arguments and linked into the empty link found by the same walk.
+    template<typename K, typename V, typename Compare = std::less<K>, typename Balance = Unbalanced, template<typename> class NodeAllocator = HeapNodeAllocator>
+    class BinarySearchMap {
+    private:
+        typedef BinarySearchTree<std::pair<const K, V>, MapKeyCompare<K, V, Compare>, Balance, NodeAllocator> m_Tree;
+        typedef typename m_Tree::m_Node m_Node;
+
+    public:
+        typedef K key_type;
+        typedef V mapped_type;
+        typedef std::pair<const K, V> value_type;
+        typedef Compare key_compare;
+        typedef typename m_Tree::iterator iterator;
+
+        //! Default constructor.
+
+        //! @param comp Comparison criteria of keys.
+        explicit BinarySearchMap(const Compare &comp = Compare()) : m_tree(MapKeyCompare<K, V, Compare>(comp)) {}
+
+        //! Inserts value constructed from arguments if key does not exist.
+
+        //! Nothing is constructed if key already exists.
+        //! @param key Key.
+        //! @param args Arguments forwarded to constructor of V.
+        //! @return Pointer to value of key and true if it was inserted.
+        template<typename... Args>
+        std::pair<V *, bool> try_emplace(const K &key, Args &&...args) {
+            return emplaceKey(key, std::forward<Args>(args)...);
+        }
+
+        //! Inserts value constructed from arguments if key does not exist.
+
+        //! Key is moved only if it is inserted.
+        //! @param key Key.
+        //! @param args Arguments forwarded to constructor of V.
+        //! @return Pointer to value of key and true if it was inserted.
+        template<typename... Args>
+        std::pair<V *, bool> try_emplace(K &&key, Args &&...args) {
+            return emplaceKey(std::move(key), std::forward<Args>(args)...);
+        }
+
+        //! Inserts value or assigns it to existing key.
+
+        //! @param key Key.
+        //! @param value Value.
+        //! @return Pointer to value of key and true if it was inserted.
+        template<typename M>
+        std::pair<V *, bool> insert_or_assign(const K &key, M &&value) {
+            return assignKey(key, std::forward<M>(value));
+        }
+
+        //! Inserts value or assigns it to existing key.
+
+        //! Key is moved only if it is inserted.
+        //! @param key Key.
+        //! @param value Value.
+        //! @return Pointer to value of key and true if it was inserted.
+        template<typename M>
+        std::pair<V *, bool> insert_or_assign(K &&key, M &&value) {
+            return assignKey(std::move(key), std::forward<M>(value));
+        }
+
+        //! Access operator.
+
+        //! Inserts value initialized V if key does not exist.
+        //! @param key Key.
+        //! @return Reference to value of key.
+        V &operator[](const K &key) { return *emplaceKey(key).first; }
+
+        //! Access operator.
+
+        //! Inserts value initialized V if key does not exist, key is moved only if it is inserted.
+        //! @param key Key.
+        //! @return Reference to value of key.
+        V &operator[](K &&key) { return *emplaceKey(std::move(key)).first; }
+
+        //! Finds value of key.
+
+        //! Value can be modified in place.
+        //! @param key Key.
+        //! @return Pointer to value, nullptr if key does not exist.
+        V *find(const K &key) {
+            m_Node *parent;
+            m_Node *node = *findLink(key, parent);
+            return node ? &node->m_data.second : nullptr;
+        }
+
+        //! Finds value of key.
+
+        //! @param key Key.
+        //! @return Pointer to value, nullptr if key does not exist.
+        const V *find(const K &key) const {
+            const m_Node *node = search(key);
+            return node ? &node->m_data.second : nullptr;
+        }
+
+        //! Checks if key exists.
+
+        //! @param key Key.
+        //! @return True if map contains key.
+        [[nodiscard]] bool contains(const K &key) const { return search(key); }
+
+        //! Removes key and its value.
+
+        //! @param key Key to remove.
+        void remove(const K &key) {
+            m_Node *parent;
+            m_tree.remove(*findLink(key, parent));
+        }
+
+        //! Clears map.
+        void clear() { m_tree.clear(); }
+
+        //! Size.
+
+        //! @return Number of keys.
+        [[nodiscard]] size_t size() const { return m_tree.size(); }
+
+        //! Iterator to element with the smallest key.
+
+        //! @return begin iterator.
+        iterator begin() const { return m_tree.begin(); }
+
+        //! Iterator to end. (nullptr)
+
+        //! @return end iterator.
+        iterator end() const { return m_tree.end(); }
+
+        //! Visits all elements in order of keys.
+
+        //! @param f Function called with key and reference to its value, which can be modified.
+        template<typename F>
+        void for_each(F f) {
+            for (auto it = begin(); it != end(); ++it) f(it->first, const_cast<V &>(it->second));
+        }
+
+        //! Returns comparison criteria of keys.
+
+        //! @return Copy of comparator.
+        Compare key_comp() const { return m_tree.comparator().key_comp(); }
+
+    private:
+        //! Finds place for key.
+
+        //! Walks down from root without recursion, compares only keys.
+        //! @param key Key to find place for.
+        //! @param parent Set to parent of returned link.
+        //! @return Pointer to link holding node with equal key, or to empty link where key belongs.
+        m_Node **findLink(const K &key, m_Node *&parent) {
+            const Compare &less = m_tree.comparator().key_comp();
+            parent = nullptr;
+            m_Node **link = &m_tree.m_rootNode;
+            while (m_Node *curr = *link) {
+                if (less(key, curr->m_data.first))
+                    link = &curr->m_leftNode;
+                else if (less(curr->m_data.first, key))
+                    link = &curr->m_rightNode;
+                else
+                    break;
+                parent = curr;
+            }
+            return link;
+        }
+
+        //! Searches for key, walks down without recursion.
+
+        //! @param key Key we are searching for.
+        //! @return Pointer to node with key if exist, nullptr otherwise.
+        const m_Node *search(const K &key) const {
+            const Compare &less = m_tree.comparator().key_comp();
+            const m_Node *curr = m_tree.m_rootNode;
+            while (curr) {
+                if (less(key, curr->m_data.first))
+                    curr = curr->m_leftNode;
+                else if (less(curr->m_data.first, key))
+                    curr = curr->m_rightNode;
+                else
+                    return curr;
+            }
+            return nullptr;
+        }
+
+        //! Private try_emplace function.
+
+        //! Creates node in place from key and arguments only if key does not exist.
+        //! @param key Key, copied or moved to new node.
+        //! @param args Arguments forwarded to constructor of V.
+        //! @return Pointer to value of key and true if it was inserted.
+        template<typename Key, typename... Args>
+        std::pair<V *, bool> emplaceKey(Key &&key, Args &&...args) {
+            m_Node *parent;
+            m_Node **link = findLink(key, parent);
+            if (*link) return {&(*link)->m_data.second, false};
+            m_Node *node = m_tree.createNode(std::in_place, nullptr, nullptr, nullptr, std::piecewise_construct,
+                                             std::forward_as_tuple(std::forward<Key>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+            m_tree.attach(link, parent, node);
+            return {&node->m_data.second, true};
+        }
+
+        //! Private insert_or_assign function.
+
+        //! @param key Key, copied or moved to new node.
+        //! @param value Value assigned to existing key or used to construct new one.
+        //! @return Pointer to value of key and true if it was inserted.
+        template<typename Key, typename M>
+        std::pair<V *, bool> assignKey(Key &&key, M &&value) {
+            m_Node *parent;
+            m_Node **link = findLink(key, parent);
+            if (*link) {
+                (*link)->m_data.second = std::forward<M>(value);
+                return {&(*link)->m_data.second, false};
+            }
+            m_Node *node = m_tree.createNode(std::in_place, nullptr, nullptr, nullptr, std::forward<Key>(key), std::forward<M>(value));
+            m_tree.attach(link, parent, node);
+            return {&node->m_data.second, true};
+        }
+
+        m_Tree m_tree;//!< Tree holding key - value pairs.
+    };
+
+}// namespace simple
+#endif// MAPBST_H
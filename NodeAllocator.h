@@ -0,0 +1,279 @@
+/**
+ * @file NodeAllocator.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief node allocation policies used by binary search tree
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef NODEALLOCATOR_H
+#define NODEALLOCATOR_H
+
+#include <cstddef>
+#include <memory>
+
+namespace simple {
+    //! Heap node allocator.
+
+    //! Allocates every node separately with general-purpose allocator.
+    //! Nodes have to be deallocated one by one, any node can be deallocated by any heap allocator.
+    template<typename NodeT>
+    class HeapNodeAllocator {
+    public:
+        //! True if allocator can free all nodes at once.
+        static constexpr bool releasesAll = false;
+
+        //! True if nodes can be allocated and deallocated from many threads at the same time.
+        static constexpr bool threadSafe = true;
+
+        //! Allocates memory for one node.
+
+        //! @return Pointer to uninitialized memory for node.
+        NodeT *allocate() { return std::allocator<NodeT>().allocate(1); }
+
+        //! Deallocates memory of one node.
+
+        //! @param ptr Pointer returned by allocate().
+        void deallocate(NodeT *ptr) { std::allocator<NodeT>().deallocate(ptr, 1); }
+
+        //! Prepares memory for given number of nodes, nothing to do for this allocator.
+
+        //! @param count Number of nodes.
+        void reserve(size_t /*count*/) {}
+
+        //! Frees all nodes at once, not supported by this allocator.
+
+        //! @return Always false, nodes have to be deallocated one by one.
+        bool release() { return false; }
+
+        //! Returns allocator which uses the same memory.
+
+        //! @return New heap allocator.
+        HeapNodeAllocator share() const { return {}; }
+
+        //! Checks if nodes can be moved between allocators.
+
+        //! @param other Other allocator.
+        //! @return Always true.
+        bool sameMemory(const HeapNodeAllocator & /*other*/) const { return true; }
+    };
+
+    //! Slab node allocator.
+
+    //! Hands out nodes from contiguous chunks, freed nodes are kept in free list and reused.
+    //! Chunks belong to arena, which can be shared by allocators of trees exchanging nodes
+    //! (see share()), such trees must not be modified from different threads at the same time.
+    //! When the last allocator using arena releases it, all chunks are freed at once.
+    template<typename NodeT>
+    class SlabNodeAllocator {
+    private:
+        //! Single slot of a chunk, either free list link, chunk header or storage for node.
+        union Slot {
+            Slot *m_next;//!< Next free slot.
+            struct {
+                Slot *m_next; //!< Next chunk.
+                size_t m_size;//!< Number of slots in chunk, header included.
+            } m_chunk;    //!< Chunk header, stored in first slot of every chunk.
+            alignas(NodeT) unsigned char m_storage[sizeof(NodeT)];//!< Storage for node.
+        };
+
+        //! Chunks and free list, shared by allocators using the same memory.
+        class Arena {
+        public:
+            //! Constructor.
+
+            //! @param chunkSize Number of nodes in first chunk.
+            explicit Arena(size_t chunkSize) : m_chunkSize(chunkSize) {}
+
+            //! Copy constructor, deleted.
+            Arena(const Arena &other) = delete;
+
+            //! Copy operator, deleted.
+            Arena &operator=(const Arena &other) = delete;
+
+            //! Destructor, frees all chunks.
+            ~Arena() {
+                while (m_chunks) {
+                    auto tmp = m_chunks;
+                    m_chunks = m_chunks->m_chunk.m_next;
+                    std::allocator<Slot>().deallocate(tmp, tmp->m_chunk.m_size);
+                }
+            }
+
+            //! Takes node from free list if possible, otherwise from current chunk.
+
+            //! @return Pointer to uninitialized memory for node.
+            NodeT *allocate() {
+                Slot *slot;
+                if (m_freeList) {
+                    slot = m_freeList;
+                    m_freeList = slot->m_next;
+                    --m_freeCount;
+                } else {
+                    if (m_bump == m_bumpEnd) grow();
+                    slot = m_bump++;
+                }
+                return reinterpret_cast<NodeT *>(slot->m_storage);
+            }
+
+            //! Puts node in free list.
+
+            //! @param ptr Pointer returned by allocate().
+            void deallocate(NodeT *ptr) {
+                auto slot = reinterpret_cast<Slot *>(ptr);
+                slot->m_next = m_freeList;
+                m_freeList = slot;
+                ++m_freeCount;
+            }
+
+            //! Prepares memory for given number of nodes.
+
+            //! Freed slots and rest of current chunk are used first. If they are not enough, rest of
+            //! current chunk goes to free list and one chunk for the missing nodes is allocated.
+            //! @param count Number of nodes.
+            void reserve(size_t count) {
+                const size_t available = m_freeCount + static_cast<size_t>(m_bumpEnd - m_bump);
+                if (available >= count) return;
+                while (m_bump != m_bumpEnd) deallocate(reinterpret_cast<NodeT *>((m_bump++)->m_storage));
+                addChunk(count - available);
+            }
+
+            //! Number of nodes which fit into all chunks.
+
+            //! @return Capacity of arena.
+            [[nodiscard]] size_t capacity() const { return m_capacity; }
+
+        private:
+            //! Allocates new chunk, every chunk is twice as big as previous one up to maxChunkSize.
+            void grow() {
+                size_t size = m_nextSize ? m_nextSize : m_chunkSize;
+                m_nextSize = size < maxChunkSize ? size * 2 : size;
+                addChunk(size);
+            }
+
+            //! Allocates new chunk and makes it current one.
+
+            //! @param size Number of nodes in chunk.
+            void addChunk(size_t size) {
+                Slot *chunk = std::allocator<Slot>().allocate(size + 1);
+                chunk->m_chunk.m_next = m_chunks;
+                chunk->m_chunk.m_size = size + 1;
+                m_chunks = chunk;
+                m_capacity += size;
+                m_bump = chunk + 1;
+                m_bumpEnd = chunk + size + 1;
+            }
+
+            static constexpr size_t maxChunkSize = 4096;//!< Maximal number of nodes in one chunk.
+
+            Slot *m_chunks{};   //!< List of allocated chunks.
+            Slot *m_freeList{}; //!< List of freed slots.
+            Slot *m_bump{};     //!< Next never used slot in newest chunk.
+            Slot *m_bumpEnd{};  //!< End of newest chunk.
+            size_t m_freeCount{};//!< Number of slots in free list.
+            size_t m_capacity{}; //!< Number of nodes in all chunks.
+            size_t m_chunkSize{};//!< Number of nodes in first chunk.
+            size_t m_nextSize{}; //!< Number of nodes in next chunk.
+        };
+
+    public:
+        //! True if allocator can free all nodes at once.
+        static constexpr bool releasesAll = true;
+
+        //! True if nodes can be allocated and deallocated from many threads at the same time.
+        static constexpr bool threadSafe = false;
+
+        //! Default constructor.
+
+        //! Arena is created with first allocation.
+        //! @param chunkSize Number of nodes in first chunk, next chunks grow up to 4096 nodes.
+        explicit SlabNodeAllocator(size_t chunkSize = 64) : m_chunkSize(chunkSize ? chunkSize : 1) {}
+
+        //! Copy constructor.
+
+        //! Copy gets its own empty arena with the same chunk size, use share() to use the same memory.
+        //! @param other Allocator to copy settings from.
+        SlabNodeAllocator(const SlabNodeAllocator &other) : m_chunkSize(other.m_chunkSize) {}
+
+        //! Move constructor.
+
+        //! @param other Allocator to move.
+        SlabNodeAllocator(SlabNodeAllocator &&other) noexcept = default;
+
+        //! Copy operator, deleted because nodes cannot change owner.
+        SlabNodeAllocator &operator=(const SlabNodeAllocator &other) = delete;
+
+        //! Move operator.
+
+        //! Drops own arena and takes arena of other allocator.
+        //! @param other Allocator to move.
+        //! @return Allocator.
+        SlabNodeAllocator &operator=(SlabNodeAllocator &&other) noexcept = default;
+
+        //! Allocates memory for one node.
+
+        //! @return Pointer to uninitialized memory for node.
+        NodeT *allocate() { return arena().allocate(); }
+
+        //! Deallocates memory of one node.
+
+        //! Memory is kept in free list for further allocations.
+        //! @param ptr Pointer returned by allocate().
+        void deallocate(NodeT *ptr) { m_arena->deallocate(ptr); }
+
+        //! Prepares memory for given number of nodes.
+
+        //! @param count Number of nodes.
+        void reserve(size_t count) {
+            if (count) arena().reserve(count);
+        }
+
+        //! Number of nodes which fit into memory allocated so far.
+
+        //! @return Capacity of arena, 0 if it was not created yet.
+        [[nodiscard]] size_t capacity() const { return m_arena ? m_arena->capacity() : 0; }
+
+        //! Frees all chunks at once.
+
+        //! Nodes allocated from slab are not destroyed. Memory is released only if
+        //! arena is not shared with other allocators.
+        //! @return True if all memory was released.
+        bool release() {
+            if (m_arena && m_arena.use_count() > 1) return false;
+            m_arena.reset();
+            return true;
+        }
+
+        //! Returns allocator which uses the same arena.
+
+        //! @return Allocator sharing memory with this one.
+        SlabNodeAllocator share() {
+            SlabNodeAllocator res(m_chunkSize);
+            arena();
+            res.m_arena = m_arena;
+            return res;
+        }
+
+        //! Checks if nodes can be moved between allocators.
+
+        //! @param other Other allocator.
+        //! @return True if both allocators use the same arena.
+        bool sameMemory(const SlabNodeAllocator &other) const { return m_arena && m_arena == other.m_arena; }
+
+    private:
+        //! Returns arena, creates it if needed.
+
+        //! @return Reference to arena.
+        Arena &arena() {
+            if (!m_arena) m_arena = std::make_shared<Arena>(m_chunkSize);
+            return *m_arena;
+        }
+
+        std::shared_ptr<Arena> m_arena;//!< Arena with chunks, shared with allocators created by share().
+        size_t m_chunkSize{};          //!< Number of nodes in first chunk.
+    };
+
+}// namespace simple
+#endif// NODEALLOCATOR_H
@@ -0,0 +1,661 @@
+/**
+ * @file PersistentBST.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief template header file for persistent binary search tree with O(1) snapshots
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef PERSISTENTBST_H
+#define PERSISTENTBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <future>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "BST.h"
+
+namespace simple {
+    //! Node of persistent binary search tree.
+
+    //! Node can be shared by many versions of tree, it counts references to itself.
+    //! Shared node is never modified, node with one reference belongs to one tree and can be changed in place.
+    template<typename T>
+    struct PersistentNode {
+        //! Constructor.
+
+        //! @param value Data to store in node.
+        template<typename V>
+        explicit PersistentNode(V &&value) : m_data(std::forward<V>(value)) {}
+
+        T m_data;                          //!< Data.
+        PersistentNode *m_leftNode{};      //!< Left child.
+        PersistentNode *m_rightNode{};     //!< Right child.
+        std::atomic<size_t> m_refs{1};     //!< Number of parents and trees pointing at node.
+        unsigned char m_height{1};         //!< Height of subtree, used by AVL balancing.
+    };
+
+    //! Persistent binary search tree forward iterator class.
+
+    //! Nodes have no parent pointers, because they are shared by many trees,
+    //! so iterator keeps stack of ancestors which are still to visit.
+    //! Iterator is valid while tree or snapshot it comes from exists and is not modified.
+    template<typename T, typename NodeT = PersistentNode<T>>
+    class PersistentTreeIterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef const T &reference;
+
+        //! Default constructor, end iterator.
+        PersistentTreeIterator() = default;
+
+        //! Copy constructor, copies only used part of stack.
+
+        //! @param other Iterator to copy.
+        PersistentTreeIterator(const PersistentTreeIterator &other) : m_depth(other.m_depth) {
+            std::copy(other.m_stack, other.m_stack + m_depth, m_stack);
+        }
+
+        //! Copy operator, copies only used part of stack.
+
+        //! @param other Iterator to copy.
+        //! @return Iterator.
+        PersistentTreeIterator &operator=(const PersistentTreeIterator &other) {
+            m_depth = other.m_depth;
+            std::copy(other.m_stack, other.m_stack + m_depth, m_stack);
+            return *this;
+        }
+
+        //! Pre-incrementation operator.
+
+        //! Increment iterator to next place, amortized O(1).
+        //! @return New iterator.
+        PersistentTreeIterator &operator++() {
+            const NodeT *node = m_stack[--m_depth]->m_rightNode;
+            pushLeft(node);
+            return *this;
+        }
+
+        //! Post-incrementation operator.
+
+        //! Increment iterator to next place.
+        //! @return Iterator before incrementation.
+        PersistentTreeIterator operator++(int) {
+            PersistentTreeIterator tmp(*this);
+            ++*this;
+            return tmp;
+        }
+
+        //! Dereference operator.
+
+        //! @return Reference to data.
+        const T &operator*() const { return m_stack[m_depth - 1]->m_data; }
+
+        //! Pointer operator.
+
+        //! @return Pointer to data.
+        const T *operator->() const { return &m_stack[m_depth - 1]->m_data; }
+
+        //! Compare operator.
+
+        //! @param other Iterator to compare with.
+        //! @return True if both iterators point at the same node.
+        bool operator==(const PersistentTreeIterator &other) const { return current() == other.current(); }
+
+        //! Difference operator.
+
+        //! @param other Iterator to compare with.
+        //! @return True if iterators point at different nodes.
+        bool operator!=(const PersistentTreeIterator &other) const { return current() != other.current(); }
+
+    private:
+        template<typename, typename>
+        friend class PersistentSnapshot;
+
+        //! Current node.
+
+        //! @return Pointer to node, nullptr for end.
+        const NodeT *current() const { return m_depth ? m_stack[m_depth - 1] : nullptr; }
+
+        //! Pushes node and all its left descendants.
+
+        //! @param node Root of subtree, may be nullptr.
+        void pushLeft(const NodeT *node) {
+            for (; node; node = node->m_leftNode) m_stack[m_depth++] = node;
+        }
+
+        static constexpr unsigned maxDepth = 96;//!< AVL tree of 2^64 nodes is lower than that.
+
+        const NodeT *m_stack[maxDepth];//!< Current node on top and its ancestors which are greater.
+        unsigned m_depth{};            //!< Number of nodes on stack, 0 for end.
+    };
+
+    //! Immutable version of persistent binary search tree.
+
+    //! Snapshot shares nodes with tree it was taken from and with other snapshots, copying it takes O(1).
+    //! Nothing reachable from snapshot is ever modified, so it can be read by many threads at the same time,
+    //! while tree it was taken from keeps changing. Snapshots can be destroyed by any thread, references
+    //! of nodes are atomic.
+    template<typename T, typename Compare = std::less<T>>
+    class PersistentSnapshot : private CompareStorage<Compare> {
+    protected:
+        typedef CompareStorage<Compare> m_CompareStorage;
+        typedef PersistentNode<T> m_Node;
+        typedef HeapNodeAllocator<m_Node> m_Allocator;
+
+    public:
+        typedef PersistentTreeIterator<T, m_Node> iterator;
+        typedef BinarySearchTreeRange<iterator> range_type;
+        typedef Compare compare_type;
+
+        //! Default constructor, empty snapshot.
+
+        //! @param comp Comparison criteria.
+        explicit PersistentSnapshot(const Compare &comp = Compare()) : m_CompareStorage(comp) {}
+
+        //! Copy constructor, O(1).
+
+        //! @param other Snapshot to share nodes with.
+        PersistentSnapshot(const PersistentSnapshot &other)
+            : m_CompareStorage(other), m_rootNode(share(other.m_rootNode)), m_numOfElements(other.m_numOfElements) {}
+
+        //! Move constructor.
+
+        //! @param other Snapshot to take nodes from, it becomes empty.
+        PersistentSnapshot(PersistentSnapshot &&other) noexcept
+            : m_CompareStorage(other), m_rootNode(std::exchange(other.m_rootNode, nullptr)), m_numOfElements(std::exchange(other.m_numOfElements, 0)) {}
+
+        //! Copy operator, O(1).
+
+        //! @param other Snapshot to share nodes with.
+        //! @return Snapshot.
+        PersistentSnapshot &operator=(const PersistentSnapshot &other) {
+            if (this != &other) {
+                m_CompareStorage::operator=(other);
+                m_Node *old = std::exchange(m_rootNode, share(other.m_rootNode));
+                m_numOfElements = other.m_numOfElements;
+                release(old);
+            }
+            return *this;
+        }
+
+        //! Move operator.
+
+        //! @param other Snapshot to take nodes from, it becomes empty.
+        //! @return Snapshot.
+        PersistentSnapshot &operator=(PersistentSnapshot &&other) noexcept {
+            if (this != &other) {
+                m_CompareStorage::operator=(other);
+                release(std::exchange(m_rootNode, std::exchange(other.m_rootNode, nullptr)));
+                m_numOfElements = std::exchange(other.m_numOfElements, 0);
+            }
+            return *this;
+        }
+
+        //! Destructor.
+
+        //! Releases nodes, those not shared with other versions are destroyed.
+        ~PersistentSnapshot() { release(m_rootNode); }
+
+        //! Search for data.
+
+        //! @param data Data to search for.
+        //! @return Pointer to found object.
+        const T *search(const T &data) const {
+            const m_Node *node = m_rootNode;
+            while (node) {
+                if (less(data, node->m_data))
+                    node = node->m_leftNode;
+                else if (less(node->m_data, data))
+                    node = node->m_rightNode;
+                else
+                    return &node->m_data;
+            }
+            return nullptr;
+        }
+
+        //! Returns comparison criteria.
+
+        //! @return Copy of comparator.
+        Compare key_comp() const { return this->comparator(); }
+
+        //! Returns size of binary search tree.
+
+        //! @return Number of elements.
+        [[nodiscard]] size_t size() const { return m_numOfElements; }
+
+        //! Returns reference to minimum object.
+
+        //! @return Reference to minimum object.
+        const T &min() const {
+            const m_Node *node = m_rootNode;
+            while (node->m_leftNode) node = node->m_leftNode;
+            return node->m_data;
+        }
+
+        //! Returns reference to maximum object.
+
+        //! @return Reference to maximum object.
+        const T &max() const {
+            const m_Node *node = m_rootNode;
+            while (node->m_rightNode) node = node->m_rightNode;
+            return node->m_data;
+        }
+
+        //! Iterator to min element.
+
+        //! @return begin iterator.
+        iterator begin() const {
+            iterator it;
+            it.pushLeft(m_rootNode);
+            return it;
+        }
+
+        //! Iterator to end.
+
+        //! @return end iterator.
+        iterator end() const { return iterator(); }
+
+        //! Iterator to first element not less than data, O(h).
+
+        //! @param data Data to compare with.
+        //! @return Iterator to found element or end iterator.
+        iterator lower_bound(const T &data) const {
+            return bound([&](const T &e) { return !less(e, data); });
+        }
+
+        //! Iterator to first element greater than data, O(h).
+
+        //! @param data Data to compare with.
+        //! @return Iterator to found element or end iterator.
+        iterator upper_bound(const T &data) const {
+            return bound([&](const T &e) { return less(data, e); });
+        }
+
+        //! Range of elements in [first, last).
+
+        //! @param first Lower bound of range, included.
+        //! @param last Upper bound of range, excluded.
+        //! @return Range which can be iterated over, empty if last is not greater than first.
+        range_type range(const T &first, const T &last) const {
+            if (!less(first, last)) return range_type(end(), end());
+            return range_type(lower_bound(first), lower_bound(last));
+        }
+
+        //! Serialize function.
+
+        //! Writes snapshot in binary format to stream, the same as BinarySearchTree::serialize(std::ostream &),
+        //! so it can be read by BinarySearchTree::deserialize().
+        //! @param os Output stream opened in binary mode.
+        void serialize(std::ostream &os) const { writeSorted<T>(os, begin(), m_numOfElements); }
+
+        //! Serialize function.
+
+        //! Writes snapshot in binary format to file, see serialize(std::ostream &).
+        //! @param fileName Name of file to save data to.
+        //! @return True if file was written.
+        bool serialize(const std::string &fileName) const {
+            std::unique_ptr<char[]> buffer(new char[streamBuffer]);
+            std::ofstream oFile;
+            oFile.rdbuf()->pubsetbuf(buffer.get(), streamBuffer);
+            oFile.open(fileName, std::ios::out | std::ios::binary);
+            if (!oFile) return false;
+            serialize(oFile);
+            oFile.close();
+            return !oFile.fail();
+        }
+
+    protected:
+        //! Compares data using comparison criteria.
+
+        //! @param a First element.
+        //! @param b Second element.
+        //! @return True if a is less than b.
+        bool less(const T &a, const T &b) const { return this->comparator()(a, b); }
+
+        //! Adds reference to node.
+
+        //! @param node Node, may be nullptr.
+        //! @return The same node.
+        static m_Node *share(m_Node *node) {
+            if (node) node->m_refs.fetch_add(1, std::memory_order_relaxed);
+            return node;
+        }
+
+        //! Drops reference to node, node without references is destroyed together with its children references.
+
+        //! @param node Node, may be nullptr.
+        static void release(m_Node *node) {
+            while (node && node->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                release(node->m_leftNode);
+                m_Node *right = node->m_rightNode;
+                node->~m_Node();
+                m_Allocator().deallocate(node);
+                node = right;
+            }
+        }
+
+        m_Node *m_rootNode{};   //!< Pointer to root node.
+        size_t m_numOfElements{};//!< Number of elements.
+
+    private:
+        static constexpr size_t streamBuffer = size_t(1) << 18;//!< Size of buffer of file stream.
+
+        //! Iterator to first element for which predicate is true, predicate has to be false then true in order.
+
+        //! @param pred Predicate.
+        //! @return Iterator to found element or end iterator.
+        template<typename Pred>
+        iterator bound(Pred pred) const {
+            iterator it;
+            // stack keeps only ancestors which are greater, as if iteration started at begin()
+            for (const m_Node *node = m_rootNode; node;) {
+                if (pred(node->m_data)) {
+                    it.m_stack[it.m_depth++] = node;
+                    node = node->m_leftNode;
+                } else {
+                    node = node->m_rightNode;
+                }
+            }
+            return it;
+        }
+    };
+
+    //! Persistent binary search tree class.
+
+    //! AVL tree whose nodes are shared with snapshots. snapshot() takes O(1), it only adds reference to root.
+    //! Update copies nodes on path from root which are shared with some snapshot and shares the rest,
+    //! so it costs O(log n) time and memory. Nodes which are not shared are changed in place, so without
+    //! snapshots tree works like ordinary balanced tree. Nodes are not copied when they are moved by rotations,
+    //! only when they are shared.
+    //! Tree itself is read and modified by one thread at a time, its snapshots by any threads.
+    template<typename T, typename Compare = std::less<T>>
+    class PersistentBinarySearchTree : public PersistentSnapshot<T, Compare> {
+    private:
+        typedef PersistentSnapshot<T, Compare> m_Snapshot;
+        typedef typename m_Snapshot::m_Node m_Node;
+        typedef typename m_Snapshot::m_Allocator m_Allocator;
+
+    public:
+        typedef m_Snapshot snapshot_type;
+
+        //! Default constructor.
+
+        //! @param comp Comparison criteria.
+        explicit PersistentBinarySearchTree(const Compare &comp = Compare()) : m_Snapshot(comp) {}
+
+        //! Initializer list constructor.
+
+        //! @param init Initializer list.
+        //! @param comp Comparison criteria.
+        PersistentBinarySearchTree(std::initializer_list<T> init, const Compare &comp = Compare()) : m_Snapshot(comp) {
+            for (const auto &e: init) insert(e);
+        }
+
+        //! Constructor, continues from snapshot in O(1).
+
+        //! @param snapshot Snapshot to share nodes with.
+        explicit PersistentBinarySearchTree(const snapshot_type &snapshot) : m_Snapshot(snapshot) {}
+
+        //! Returns immutable version of tree, O(1).
+
+        //! @return Snapshot sharing all nodes with tree.
+        snapshot_type snapshot() const { return snapshot_type(*this); }
+
+        //! Writes tree to file in background thread.
+
+        //! Snapshot is taken in O(1) and written by new thread, see PersistentSnapshot::serialize(). Tree can be
+        //! modified meanwhile, updates copy nodes shared with snapshot, so they do not wait for writing.
+        //! @param fileName Name of file to save data to.
+        //! @return Future which becomes true when file was written.
+        std::future<bool> serialize_async(const std::string &fileName) const {
+            return std::async(std::launch::async, [snapshot = snapshot(), fileName] { return snapshot.serialize(fileName); });
+        }
+
+        //! Inserts data to binary search tree.
+
+        //! @param data Data.
+        //! @return True if data was inserted, false if equal data already exists.
+        bool insert(const T &data) { return insertValue(data); }
+
+        //! Inserts data to binary search tree. (moves)
+
+        //! @param data Data.
+        //! @return True if data was inserted, false if equal data already exists.
+        bool insert(T &&data) { return insertValue(std::move(data)); }
+
+        //! Removes data from binary search tree.
+
+        //! Node of removed element is replaced by its successor, data is not moved.
+        //! @param data Data to remove.
+        //! @return True if data was removed.
+        bool remove(const T &data) {
+            if (!this->search(data)) return false;
+            Path path;
+            m_Node **link = descend(data, path);
+            m_Node *node = *link;
+            // children are moved out of removed node if tree owns it, otherwise shared
+            const bool owned = node->m_refs.load(std::memory_order_acquire) == 1;
+            m_Node *left = owned ? std::exchange(node->m_leftNode, nullptr) : this->share(node->m_leftNode);
+            m_Node *right = owned ? std::exchange(node->m_rightNode, nullptr) : this->share(node->m_rightNode);
+            if (left && right) {
+                const size_t index = path.size();
+                path.push(link);
+                m_Node **succLink = &right;
+                try {
+                    while (true) {
+                        *succLink = own(*succLink);
+                        if (!(*succLink)->m_leftNode) break;
+                        path.push(succLink);
+                        succLink = &(*succLink)->m_leftNode;
+                    }
+                } catch (...) {
+                    if (owned) {
+                        node->m_leftNode = left;
+                        node->m_rightNode = right;
+                    } else {
+                        this->release(left);
+                        this->release(right);
+                    }
+                    throw;
+                }
+                m_Node *succ = *succLink;
+                *succLink = succ->m_rightNode;
+                succ->m_leftNode = left;
+                succ->m_rightNode = right;
+                *link = succ;
+                // path went through local right, successor holds it now
+                if (path.size() > index + 1) path[index + 1] = &succ->m_rightNode;
+            } else {
+                *link = left ? left : right;
+            }
+            this->release(node);
+            --this->m_numOfElements;
+            rebalance(path);
+            return true;
+        }
+
+        //! Clears binary search tree, nodes shared with snapshots stay.
+        void clear() {
+            this->release(std::exchange(this->m_rootNode, nullptr));
+            this->m_numOfElements = 0;
+        }
+
+    private:
+        //! Links from root to place of update, every link belongs to node owned by tree.
+        class Path {
+        public:
+            //! Adds link at the end of path.
+
+            //! @param link Link.
+            void push(m_Node **link) { m_links[m_size++] = link; }
+
+            //! Returns number of links.
+
+            //! @return Number of links.
+            [[nodiscard]] size_t size() const { return m_size; }
+
+            //! Access operator.
+
+            //! @param index Index of link.
+            //! @return Reference to link.
+            m_Node **&operator[](size_t index) { return m_links[index]; }
+
+        private:
+            static constexpr size_t maxDepth = 96;//!< AVL tree of 2^64 nodes is lower than that.
+
+            m_Node **m_links[maxDepth];//!< Links, from root down.
+            size_t m_size{};           //!< Number of links.
+        };
+
+        //! Private insert function.
+
+        //! @param data Data to insert.
+        //! @return True if data was inserted.
+        template<typename V>
+        bool insertValue(V &&data) {
+            if (this->search(data)) return false;
+            Path path;
+            m_Node **link = descend(data, path);
+            *link = createNode(std::forward<V>(data));
+            ++this->m_numOfElements;
+            rebalance(path);
+            return true;
+        }
+
+        //! Walks from root to data and makes tree owner of every node on the way.
+
+        //! Shared nodes are copied, so if copying throws tree still has the same elements.
+        //! @param data Data to search for.
+        //! @param path Filled with links to owned nodes, from root.
+        //! @return Link to node equal to data, which is not owned yet, or to empty place where data belongs.
+        m_Node **descend(const T &data, Path &path) {
+            m_Node **link = &this->m_rootNode;
+            while (m_Node *node = *link) {
+                const bool goLeft = this->less(data, node->m_data);
+                if (!goLeft && !this->less(node->m_data, data)) break;
+                node = *link = own(node);
+                path.push(link);
+                link = goLeft ? &node->m_leftNode : &node->m_rightNode;
+            }
+            return link;
+        }
+
+        //! Returns node which belongs only to tree.
+
+        //! @param node Node referenced by link of tree.
+        //! @return The same node if it is not shared, otherwise its copy which shares children, link has to be set to it.
+        m_Node *own(m_Node *node) {
+            if (node->m_refs.load(std::memory_order_acquire) == 1) return node;
+            m_Node *copy = createNode(node->m_data);
+            copy->m_leftNode = this->share(node->m_leftNode);
+            copy->m_rightNode = this->share(node->m_rightNode);
+            copy->m_height = node->m_height;
+            this->release(node);
+            return copy;
+        }
+
+        //! Restores AVL balance on path, from bottom up.
+
+        //! If copying of shared node throws, tree keeps all elements, but may stay less balanced.
+        //! @param path Path of changed nodes.
+        void rebalance(Path &path) {
+            for (size_t i = path.size(); i--;) *path[i] = balance(*path[i]);
+        }
+
+        //! Balances owned node whose subtrees differ in height at most by 2.
+
+        //! @param node Node.
+        //! @return New root of subtree.
+        m_Node *balance(m_Node *node) {
+            const int diff = height(node->m_leftNode) - height(node->m_rightNode);
+            if (diff > 1) {
+                m_Node *left = node->m_leftNode = own(node->m_leftNode);
+                if (height(left->m_leftNode) < height(left->m_rightNode)) {
+                    left->m_rightNode = own(left->m_rightNode);
+                    node->m_leftNode = rotateLeft(left);
+                }
+                return rotateRight(node);
+            }
+            if (diff < -1) {
+                m_Node *right = node->m_rightNode = own(node->m_rightNode);
+                if (height(right->m_rightNode) < height(right->m_leftNode)) {
+                    right->m_leftNode = own(right->m_leftNode);
+                    node->m_rightNode = rotateRight(right);
+                }
+                return rotateLeft(node);
+            }
+            update(node);
+            return node;
+        }
+
+        //! Rotates owned node and its owned left child to the right.
+
+        //! @param node Node.
+        //! @return New root of subtree.
+        static m_Node *rotateRight(m_Node *node) {
+            m_Node *left = node->m_leftNode;
+            node->m_leftNode = left->m_rightNode;
+            left->m_rightNode = node;
+            update(node);
+            update(left);
+            return left;
+        }
+
+        //! Rotates owned node and its owned right child to the left.
+
+        //! @param node Node.
+        //! @return New root of subtree.
+        static m_Node *rotateLeft(m_Node *node) {
+            m_Node *right = node->m_rightNode;
+            node->m_rightNode = right->m_leftNode;
+            right->m_leftNode = node;
+            update(node);
+            update(right);
+            return right;
+        }
+
+        //! Returns height of subtree.
+
+        //! @param node Root of subtree, may be nullptr.
+        //! @return Height, 0 for empty subtree.
+        static int height(const m_Node *node) { return node ? node->m_height : 0; }
+
+        //! Recomputes height of node from its children.
+
+        //! @param node Node.
+        static void update(m_Node *node) {
+            node->m_height = static_cast<unsigned char>(1 + std::max(height(node->m_leftNode), height(node->m_rightNode)));
+        }
+
+        //! Creates node.
+
+        //! @param data Data forwarded to constructor of node.
+        //! @return Pointer to new node with one reference.
+        template<typename V>
+        static m_Node *createNode(V &&data) {
+            m_Node *mem = m_Allocator().allocate();
+            try {
+                return new (mem) m_Node(std::forward<V>(data));
+            } catch (...) {
+                m_Allocator().deallocate(mem);
+                throw;
+            }
+        }
+    };
+
+}// namespace simple
+#endif// PERSISTENTBST_H
@@ -0,0 +1,192 @@
+/**
+ * @file Serialize.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief binary formats of serialized binary search trees
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+namespace simple {
+    inline constexpr uint64_t rawMagic = 0x3130574152545342;   //!< "BSTRAW01", starts file with raw block of elements.
+    inline constexpr uint64_t packedMagic = 0x31304b4150545342;//!< "BSTPAK01", starts file with packed blocks of integral elements.
+    inline constexpr size_t rawChunk = size_t(1) << 20;        //!< Bytes written or read at once by raw and packed formats.
+    inline constexpr size_t packedBlock = 128;                 //!< Number of elements in packed block.
+
+    //! True if elements are written as packed blocks.
+    template<typename T>
+    inline constexpr bool packedElement = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+    //! Stores lowest bytes of value in little endian order.
+
+    //! @param out Destination.
+    //! @param value Value.
+    //! @param bytes Number of bytes to store, at most 8.
+    inline void storeLittle(char *out, uint64_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; ++i) out[i] = static_cast<char>(value >> (8 * i));
+    }
+
+    //! Loads value stored in little endian order.
+
+    //! @param in Source.
+    //! @param bytes Number of bytes to load, at most 8.
+    //! @return Value.
+    inline uint64_t loadLittle(const char *in, size_t bytes) {
+        uint64_t value{};
+        for (size_t i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+        return value;
+    }
+
+    //! Writes elements as raw block.
+
+    //! Header is magic number, size of element and number of elements, all 64 bit, then elements follow in order.
+    //! Elements are copied to buffer of rawChunk bytes, which is written at once.
+    //! @param os Output stream.
+    //! @param first Iterator to the smallest element.
+    //! @param count Number of elements.
+    template<typename T, typename InputIt>
+    void writeRaw(std::ostream &os, InputIt first, size_t count) {
+        const uint64_t header[3] = {rawMagic, sizeof(T), count};
+        os.write(reinterpret_cast<const char *>(header), sizeof(header));
+        const size_t chunk = std::min(count, std::max<size_t>(rawChunk / sizeof(T), 1)) * sizeof(T);
+        std::unique_ptr<char[]> buffer(new char[chunk]);
+        size_t used{};
+        for (size_t i = 0; i < count; ++i, ++first) {
+            std::memcpy(buffer.get() + used, &*first, sizeof(T));
+            used += sizeof(T);
+            if (used == chunk) {
+                os.write(buffer.get(), static_cast<std::streamsize>(used));
+                used = 0;
+            }
+        }
+        if (used) os.write(buffer.get(), static_cast<std::streamsize>(used));
+    }
+
+    //! Writes elements as packed blocks after header.
+
+    //! Block holds packedBlock elements, the last one can be shorter. It starts with bit width of block
+    //! and its first element, following elements are stored as zigzag encoded differences to previous
+    //! element, packed with the bit width of the largest one. In order sequence has small differences,
+    //! so dense keys take few bits. Bits are stored in little endian order.
+    //! @param os Output stream.
+    //! @param first Iterator to the smallest element.
+    //! @param count Number of elements.
+    template<typename T, typename InputIt>
+    void writePacked(std::ostream &os, InputIt first, size_t count) {
+        typedef std::make_unsigned_t<T> Unsigned;
+        const uint64_t header[3] = {packedMagic, sizeof(T), count};
+        os.write(reinterpret_cast<const char *>(header), sizeof(header));
+        const size_t maxBlock = 1 + sizeof(T) + (packedBlock - 1) * sizeof(uint64_t);
+        std::unique_ptr<char[]> buffer(new char[rawChunk + maxBlock]);
+        size_t used{};
+        uint64_t deltas[packedBlock - 1];
+        for (size_t left = count; left;) {
+            const size_t size = std::min(left, packedBlock);
+            const auto base = static_cast<Unsigned>(*first);
+            Unsigned prev = base;
+            uint64_t bits{};
+            ++first;
+            for (size_t i = 0; i + 1 < size; ++i, ++first) {
+                const auto value = static_cast<Unsigned>(*first);
+                const auto delta = static_cast<std::make_signed_t<Unsigned>>(static_cast<Unsigned>(value - prev));
+                deltas[i] = static_cast<Unsigned>(static_cast<Unsigned>(static_cast<Unsigned>(delta) << 1) ^ static_cast<Unsigned>(delta >> (8 * sizeof(T) - 1)));
+                bits |= deltas[i];
+                prev = value;
+            }
+            left -= size;
+            unsigned width{};
+            while (width < 64 && bits >> width) ++width;
+
+            char *out = buffer.get() + used;
+            *out++ = static_cast<char>(width);
+            storeLittle(out, base, sizeof(T));
+            out += sizeof(T);
+            uint64_t word{};
+            unsigned filled{};
+            for (size_t i = 0; i + 1 < size; ++i) {
+                word |= deltas[i] << filled;
+                if (filled + width >= 64) {
+                    storeLittle(out, word, sizeof(word));
+                    out += sizeof(word);
+                    word = filled ? deltas[i] >> (64 - filled) : 0;
+                    filled = filled + width - 64;
+                } else {
+                    filled += width;
+                }
+            }
+            storeLittle(out, word, (filled + 7) / 8);
+            out += (filled + 7) / 8;
+
+            used = static_cast<size_t>(out - buffer.get());
+            if (used >= rawChunk) {
+                os.write(buffer.get(), static_cast<std::streamsize>(used));
+                used = 0;
+            }
+        }
+        if (used) os.write(buffer.get(), static_cast<std::streamsize>(used));
+    }
+
+    //! Writes length prefixed string.
+
+    //! @param os Output stream.
+    //! @param data String.
+    inline void writeString(std::ostream &os, const std::string &data) {
+        const size_t strSize = data.size();
+        os.write(reinterpret_cast<const char *>(&strSize), sizeof(strSize));
+        os.write(data.data(), static_cast<std::streamsize>(strSize));
+    }
+
+    //! Writes number of elements and elements as length prefixed strings.
+
+    //! std::string elements are written directly, other types formatted by << operator.
+    //! @param os Output stream.
+    //! @param first Iterator to the smallest element.
+    //! @param count Number of elements.
+    template<typename T, typename InputIt>
+    void writeStrings(std::ostream &os, InputIt first, size_t count) {
+        os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        std::ostringstream ss;
+        for (size_t i = 0; i < count; ++i, ++first) {
+            if constexpr (std::is_same_v<T, std::string>) {
+                writeString(os, *first);
+            } else {
+                ss.str(std::string());
+                ss << *first;
+                writeString(os, ss.str());
+            }
+        }
+    }
+
+    //! Writes sorted elements in format read by BinarySearchTree::deserialize().
+
+    //! Integral elements are written as packed blocks, other trivially copyable elements as raw block,
+    //! other elements as length prefixed strings.
+    //! @param os Output stream opened in binary mode.
+    //! @param first Iterator to the smallest element.
+    //! @param count Number of elements.
+    template<typename T, typename InputIt>
+    void writeSorted(std::ostream &os, InputIt first, size_t count) {
+        if constexpr (packedElement<T>)
+            writePacked<T>(os, first, count);
+        else if constexpr (std::is_trivially_copyable_v<T>)
+            writeRaw<T>(os, first, count);
+        else
+            writeStrings<T>(os, first, count);
+    }
+
+}// namespace simple
+#endif// SERIALIZE_H
@@ -0,0 +1,409 @@
+/**
+ * @file ShardedBST.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief template header file for binary search tree partitioned into range shards
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef SHARDEDBST_H
+#define SHARDEDBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+
+#include "BST.h"
+
+namespace simple {
+    //! Sharded binary search tree class.
+
+    //! Key space is split by boundaries into range shards, every shard is red-black BinarySearchTree
+    //! with its own mutex, so writers of different key ranges do not wait for each other.
+    //! Shard i holds elements not less than boundary i - 1 and less than boundary i.
+    //! Boundaries are set by rebalance(), until then all elements go to the first shard. Rebalance runs
+    //! automatically when shard grows to 3/2 or shrinks to 1/2 of average size, it moves elements between
+    //! neighbouring shards with split() and join() of shards, which takes O(log n) per shard.
+    //! Operations on elements lock layout of shards for reading, rebalance locks it for writing.
+    template<typename T, typename Compare = std::less<T>>
+    class ShardedBinarySearchTree : private CompareStorage<Compare> {
+    private:
+        typedef CompareStorage<Compare> m_CompareStorage;
+
+    public:
+        typedef BinarySearchTree<T, Compare, RedBlack, HeapNodeAllocator, true> shard_type;
+        typedef Compare compare_type;
+
+        //! Forward iterator over all shards, in order.
+
+        //! Iterator must not be used while other threads modify tree, for_each() can be used then.
+        class iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef T value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const T *pointer;
+            typedef const T &reference;
+
+            //! Default constructor.
+            iterator() = default;
+
+            //! Dereference operator.
+
+            //! @return Reference to data.
+            const T &operator*() const { return *m_it; }
+
+            //! Pointer operator.
+
+            //! @return Pointer to data.
+            const T *operator->() const { return &*m_it; }
+
+            //! Pre-incrementation operator, continues with next shard at end of shard.
+
+            //! @return New iterator.
+            iterator &operator++() {
+                ++m_it;
+                if (m_it == m_tree->m_shards[m_shard].m_tree.end()) skipEmpty(m_shard + 1);
+                return *this;
+            }
+
+            //! Post-incrementation operator.
+
+            //! @return Iterator before incrementation.
+            iterator operator++(int) {
+                iterator tmp(*this);
+                ++*this;
+                return tmp;
+            }
+
+            //! Compare operator.
+
+            //! @param other Iterator to compare with.
+            //! @return True if both iterators point at the same element.
+            bool operator==(const iterator &other) const { return m_it == other.m_it; }
+
+            //! Difference operator.
+
+            //! @param other Iterator to compare with.
+            //! @return True if iterators point at different elements.
+            bool operator!=(const iterator &other) const { return m_it != other.m_it; }
+
+        private:
+            friend class ShardedBinarySearchTree;
+
+            //! Constructor used by tree.
+
+            //! @param tree Tree.
+            //! @param shard First shard to look at.
+            iterator(const ShardedBinarySearchTree *tree, size_t shard) : m_tree(tree) { skipEmpty(shard); }
+
+            //! Moves to the first element of the first non empty shard, or to end.
+
+            //! @param shard First shard to look at.
+            void skipEmpty(size_t shard) {
+                for (m_shard = shard; m_shard < m_tree->m_numOfShards; ++m_shard) {
+                    const shard_type &tree = m_tree->m_shards[m_shard].m_tree;
+                    if (tree.size()) {
+                        m_it = tree.lower_bound(tree.min());
+                        return;
+                    }
+                }
+                m_it = typename shard_type::iterator();
+            }
+
+            const ShardedBinarySearchTree *m_tree{};//!< Tree.
+            size_t m_shard{};                        //!< Index of current shard.
+            typename shard_type::iterator m_it;      //!< Position in current shard.
+        };
+
+        //! Constructor.
+
+        //! @param shards Number of shards, at least one.
+        //! @param comp Comparison criteria.
+        explicit ShardedBinarySearchTree(size_t shards = std::thread::hardware_concurrency(), const Compare &comp = Compare())
+            : m_CompareStorage(comp), m_numOfShards(shards ? shards : 1), m_shards(new Shard[m_numOfShards]),
+              m_bounds(new T[m_numOfShards - 1]) {
+            for (size_t i = 0; i < m_numOfShards; ++i) m_shards[i].m_tree = shard_type(comp);
+        }
+
+        //! Initializer list constructor.
+
+        //! @param init Initializer list.
+        //! @param shards Number of shards, at least one.
+        //! @param comp Comparison criteria.
+        ShardedBinarySearchTree(std::initializer_list<T> init, size_t shards = std::thread::hardware_concurrency(), const Compare &comp = Compare())
+            : ShardedBinarySearchTree(shards, comp) {
+            for (const auto &e: init) insert(e);
+        }
+
+        //! Copy constructor, deleted.
+        ShardedBinarySearchTree(const ShardedBinarySearchTree &other) = delete;
+
+        //! Copy operator, deleted.
+        ShardedBinarySearchTree &operator=(const ShardedBinarySearchTree &other) = delete;
+
+        //! Inserts data to binary search tree.
+
+        //! @param data Data.
+        //! @return True if data was inserted, false if equal data already exists.
+        bool insert(const T &data) { return insertValue(data); }
+
+        //! Inserts data to binary search tree. (moves)
+
+        //! @param data Data.
+        //! @return True if data was inserted, false if equal data already exists.
+        bool insert(T &&data) { return insertValue(std::move(data)); }
+
+        //! Removes data from binary search tree.
+
+        //! @param data Data to remove.
+        //! @return True if data was removed.
+        bool remove(const T &data) {
+            bool removed, skewed;
+            {
+                std::shared_lock<std::shared_mutex> layout(m_layoutMutex);
+                Shard &shard = m_shards[shardOf(data)];
+                std::lock_guard<std::mutex> lock(shard.m_mutex);
+                const size_t before = shard.m_tree.size();
+                shard.m_tree.remove(data);
+                removed = shard.m_tree.size() != before;
+                skewed = removed && isSkewed(shard.m_tree.size(), m_numOfElements.fetch_sub(1, std::memory_order_relaxed) - 1);
+            }
+            if (skewed) rebalance();
+            return removed;
+        }
+
+        //! Search for data.
+
+        //! @param data Data to search for.
+        //! @return True if equal data exists.
+        bool search(const T &data) const {
+            std::shared_lock<std::shared_mutex> layout(m_layoutMutex);
+            const Shard &shard = m_shards[shardOf(data)];
+            std::lock_guard<std::mutex> lock(shard.m_mutex);
+            return shard.m_tree.search(data);
+        }
+
+        //! Search for data, copies found element.
+
+        //! Reference to element cannot be returned, because it can be removed by other thread.
+        //! @param data Data to search for.
+        //! @param result Set to copy of equal element if it exists.
+        //! @return True if equal data exists.
+        bool search(const T &data, T &result) const {
+            std::shared_lock<std::shared_mutex> layout(m_layoutMutex);
+            const Shard &shard = m_shards[shardOf(data)];
+            std::lock_guard<std::mutex> lock(shard.m_mutex);
+            const T *found = shard.m_tree.search(data);
+            if (found) result = *found;
+            return found;
+        }
+
+        //! Calls function for every element, in order.
+
+        //! All shards are locked for the time of call, so function sees consistent state of tree.
+        //! It must not modify tree.
+        //! @param f Function called with const reference to element.
+        template<typename F>
+        void for_each(F f) const {
+            std::shared_lock<std::shared_mutex> layout(m_layoutMutex);
+            ShardLock lock(m_shards.get(), m_shards.get() + m_numOfShards);
+            for (size_t i = 0; i < m_numOfShards; ++i) {
+                const shard_type &tree = m_shards[i].m_tree;
+                if (!tree.size()) continue;
+                for (auto it = tree.lower_bound(tree.min()); it != tree.end(); ++it) f(*it);
+            }
+        }
+
+        //! Calls function for every element in [first, last), in order.
+
+        //! Only shards overlapping range are locked, all of them for the time of call, so function
+        //! sees consistent state of range. It must not modify tree.
+        //! @param first Lower bound of range, included.
+        //! @param last Upper bound of range, excluded.
+        //! @param f Function called with const reference to element.
+        template<typename F>
+        void for_each(const T &first, const T &last, F f) const {
+            if (!less(first, last)) return;
+            std::shared_lock<std::shared_mutex> layout(m_layoutMutex);
+            const size_t begin = shardOf(first), end = shardOf(last) + 1;
+            ShardLock lock(m_shards.get() + begin, m_shards.get() + end);
+            for (size_t i = begin; i < end; ++i)
+                for (const auto &e: m_shards[i].m_tree.range(first, last)) f(e);
+        }
+
+        //! Iterator to min element.
+
+        //! @return begin iterator.
+        iterator begin() const { return iterator(this, 0); }
+
+        //! Iterator to end.
+
+        //! @return end iterator.
+        iterator end() const { return iterator(this, m_numOfShards); }
+
+        //! Returns size of binary search tree.
+
+        //! @return Number of elements, may be outdated while other threads modify tree.
+        [[nodiscard]] size_t size() const { return m_numOfElements.load(std::memory_order_relaxed); }
+
+        //! Returns number of shards.
+
+        //! @return Number of shards.
+        [[nodiscard]] size_t shards() const { return m_numOfShards; }
+
+        //! Returns comparison criteria.
+
+        //! @return Copy of comparator used by binary search tree.
+        Compare key_comp() const { return this->comparator(); }
+
+        //! Moves elements between shards, so all of them have the same size.
+
+        //! Boundaries are set to minimums of shards. Nothing is done if tree has less than
+        //! minShardSize elements per shard, empty shards would have no boundaries then.
+        void rebalance() {
+            // one rebalance at a time is enough, others would find tree balanced
+            if (m_rebalancing.exchange(true, std::memory_order_acquire)) return;
+            std::unique_lock<std::shared_mutex> layout(m_layoutMutex);
+            const size_t total = m_numOfElements.load(std::memory_order_relaxed);
+            if (m_numOfShards > 1 && total >= m_numOfShards * minShardSize) {
+                for (size_t i = 0; i + 1 < m_numOfShards; ++i) {
+                    shard_type &curr = m_shards[i].m_tree;
+                    const size_t want = total / m_numOfShards + (i < total % m_numOfShards);
+                    if (curr.size() > want) {
+                        // surplus goes to the front of next shard
+                        const T key = *curr.nth(want);
+                        shard_type tail = curr.split(key);
+                        tail.join(m_shards[i + 1].m_tree);
+                        m_shards[i + 1].m_tree = std::move(tail);
+                    }
+                    // missing elements are taken from fronts of next shards
+                    for (size_t j = i + 1; curr.size() < want; ++j) {
+                        shard_type &next = m_shards[j].m_tree;
+                        const size_t missing = want - curr.size();
+                        if (next.size() > missing) {
+                            const T key = *next.nth(missing);
+                            shard_type rest = next.split(key);
+                            curr.join(next);
+                            next = std::move(rest);
+                        } else {
+                            curr.join(next);
+                        }
+                    }
+                    m_bounds[i] = m_shards[i + 1].m_tree.min();
+                }
+                m_numOfBounds = m_numOfShards - 1;
+            }
+            m_rebalancing.store(false, std::memory_order_release);
+        }
+
+        //! Clears binary search tree, boundaries are forgotten.
+        void clear() {
+            std::unique_lock<std::shared_mutex> layout(m_layoutMutex);
+            for (size_t i = 0; i < m_numOfShards; ++i) m_shards[i].m_tree.clear();
+            m_numOfBounds = 0;
+            m_numOfElements.store(0, std::memory_order_relaxed);
+        }
+
+        static constexpr size_t minShardSize = 1024;//!< Minimal average size of shard for rebalance.
+
+    private:
+        //! Shard with its lock, on its own cache line.
+        struct alignas(64) Shard {
+            mutable std::mutex m_mutex;//!< Lock guarding tree.
+            shard_type m_tree;         //!< Elements of shard.
+        };
+
+        //! Keeps range of shards locked.
+        class ShardLock {
+        public:
+            //! Constructor, locks shards in order.
+
+            //! @param first First shard.
+            //! @param last Past last shard.
+            ShardLock(Shard *first, Shard *last) : m_first(first), m_last(first) {
+                for (; m_last != last; ++m_last) m_last->m_mutex.lock();
+            }
+
+            //! Copy constructor, deleted.
+            ShardLock(const ShardLock &other) = delete;
+
+            //! Copy operator, deleted.
+            ShardLock &operator=(const ShardLock &other) = delete;
+
+            //! Destructor, unlocks shards.
+            ~ShardLock() {
+                for (Shard *shard = m_first; shard != m_last; ++shard) shard->m_mutex.unlock();
+            }
+
+        private:
+            Shard *m_first;//!< First locked shard.
+            Shard *m_last; //!< Past last locked shard.
+        };
+
+        //! Compares data using comparison criteria.
+
+        //! @param a First element.
+        //! @param b Second element.
+        //! @return True if a is less than b.
+        bool less(const T &a, const T &b) const { return this->comparator()(a, b); }
+
+        //! Finds shard of data.
+
+        //! Caller has to lock layout.
+        //! @param data Data.
+        //! @return Index of shard whose range contains data.
+        size_t shardOf(const T &data) const {
+            return std::upper_bound(m_bounds.get(), m_bounds.get() + m_numOfBounds, data, this->comparator()) - m_bounds.get();
+        }
+
+        //! Checks if shard is too big or too small.
+
+        //! @param size Size of shard.
+        //! @param total Size of tree.
+        //! @return True if tree should be rebalanced.
+        bool isSkewed(size_t size, size_t total) const {
+            if (m_numOfShards < 2 || total < m_numOfShards * minShardSize) return false;
+            return 2 * size * m_numOfShards > 3 * total || 2 * size * m_numOfShards < total;
+        }
+
+        //! Private insert function.
+
+        //! @param data Data to insert.
+        //! @return True if data was inserted.
+        template<typename V>
+        bool insertValue(V &&data) {
+            bool inserted, skewed;
+            {
+                std::shared_lock<std::shared_mutex> layout(m_layoutMutex);
+                Shard &shard = m_shards[shardOf(data)];
+                std::lock_guard<std::mutex> lock(shard.m_mutex);
+                const size_t before = shard.m_tree.size();
+                shard.m_tree.insert(std::forward<V>(data));
+                inserted = shard.m_tree.size() != before;
+                skewed = inserted && isSkewed(shard.m_tree.size(), m_numOfElements.fetch_add(1, std::memory_order_relaxed) + 1);
+            }
+            if (skewed) rebalance();
+            return inserted;
+        }
+
+        const size_t m_numOfShards;              //!< Number of shards.
+        std::unique_ptr<Shard[]> m_shards;       //!< Shards, in order of their ranges.
+        std::unique_ptr<T[]> m_bounds;           //!< Minimums of shards except the first one.
+        size_t m_numOfBounds{};                  //!< Number of set boundaries, 0 before first rebalance.
+        mutable std::shared_mutex m_layoutMutex; //!< Lock guarding boundaries and moves between shards.
+        std::atomic<size_t> m_numOfElements{};   //!< Number of elements.
+        std::atomic<bool> m_rebalancing{};       //!< True while rebalance runs.
+    };
+
+}// namespace simple
+#endif// SHARDEDBST_H
@@ -0,0 +1,278 @@
+/**
+ * @file ThreadPool.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief work-stealing thread pool used by parallel operations of binary search tree
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace simple {
+    //! Work-stealing thread pool.
+
+    //! Runs fork-join jobs. Job passed to run() is executed on calling thread, which together with
+    //! threads of pool executes tasks forked by invoke(). Every thread has its own deque of forked
+    //! tasks, owner pushes and pops them at bottom, idle threads steal the oldest ones from top.
+    //! Only one job runs at a time, run() called from other threads waits for its turn.
+    class ThreadPool {
+    public:
+        //! Default number of elements below which parallel operations run sequentially.
+        static constexpr size_t defaultGrain = 4096;
+
+        //! Constructor.
+
+        //! @param threads Number of threads executing jobs, calling thread of run() included.
+        explicit ThreadPool(size_t threads = std::thread::hardware_concurrency())
+            : m_size(threads ? threads : 1), m_workers(new Worker[m_size]), m_threads(new std::thread[m_size - 1]) {
+            for (size_t i = 1; i < m_size; ++i)
+                m_threads[i - 1] = std::thread([this, i] { work(i); });
+        }
+
+        //! Copy constructor, deleted.
+        ThreadPool(const ThreadPool &other) = delete;
+
+        //! Copy operator, deleted.
+        ThreadPool &operator=(const ThreadPool &other) = delete;
+
+        //! Destructor, stops and joins all threads.
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (size_t i = 0; i + 1 < m_size; ++i) m_threads[i].join();
+        }
+
+        //! Returns number of threads.
+
+        //! @return Number of threads executing jobs, calling thread of run() included.
+        [[nodiscard]] size_t size() const { return m_size; }
+
+        //! Runs job with all threads of pool.
+
+        //! Returns when job and all tasks forked by it are done. Exception thrown by job is rethrown.
+        //! If called from inside of job of this pool, job is simply executed.
+        //! @param job Function to run.
+        template<typename Job>
+        void run(Job &&job) {
+            if (s_pool == this) {
+                job();
+                return;
+            }
+            std::lock_guard<std::mutex> runLock(m_runMutex);
+            ThreadPool *prevPool = s_pool;
+            Worker *prevWorker = s_worker;
+            s_pool = this;
+            s_worker = &m_workers[0];
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_active.store(true, std::memory_order_release);
+            }
+            m_wake.notify_all();
+            std::exception_ptr error;
+            try {
+                job();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            m_active.store(false, std::memory_order_release);
+            s_pool = prevPool;
+            s_worker = prevWorker;
+            if (error) std::rethrow_exception(error);
+        }
+
+        //! Runs two functions, possibly in parallel.
+
+        //! Second function is offered to other threads, first one is executed right away. If nobody
+        //! took second function it is executed by calling thread, otherwise calling thread executes
+        //! other tasks until it is done. Outside of job of this pool both functions run sequentially.
+        //! Exception thrown by any function is rethrown after both of them are done.
+        //! @param first First function.
+        //! @param second Second function.
+        template<typename F1, typename F2>
+        void invoke(F1 &&first, F2 &&second) {
+            if (s_pool != this) {
+                first();
+                second();
+                return;
+            }
+            Worker *worker = s_worker;
+            FunctionTask<F2> task(second);
+            if (!worker->push(&task)) {
+                first();
+                second();
+                return;
+            }
+            std::exception_ptr error;
+            try {
+                first();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            if (worker->pop(&task)) {
+                task.execute();
+            } else {
+                while (!task.m_done.load(std::memory_order_acquire))
+                    if (!steal(worker)) std::this_thread::yield();
+            }
+            if (error) std::rethrow_exception(error);
+            if (task.m_error) std::rethrow_exception(task.m_error);
+        }
+
+    private:
+        //! Forked task.
+        class Task {
+        public:
+            //! Executes task, stores thrown exception and marks task as done.
+            void execute() {
+                try {
+                    m_run(this);
+                } catch (...) {
+                    m_error = std::current_exception();
+                }
+                m_done.store(true, std::memory_order_release);
+            }
+
+            std::atomic<bool> m_done{};//!< True when task is done, owner may destroy it then.
+            std::exception_ptr m_error;//!< Exception thrown by task.
+
+        protected:
+            //! Constructor.
+
+            //! @param run Function which executes task.
+            explicit Task(void (*run)(Task *)) : m_run(run) {}
+
+        private:
+            void (*m_run)(Task *);//!< Function which executes task.
+        };
+
+        //! Task calling function object, lives on stack of invoke().
+        template<typename F>
+        class FunctionTask : public Task {
+        public:
+            //! Constructor.
+
+            //! @param function Function to call, it has to outlive task.
+            explicit FunctionTask(F &function) : Task(&FunctionTask::call), m_function(function) {}
+
+        private:
+            //! Calls function of task.
+
+            //! @param task Task to execute.
+            static void call(Task *task) { static_cast<FunctionTask *>(task)->m_function(); }
+
+            F &m_function;//!< Function to call.
+        };
+
+        //! Deque of tasks forked by one thread.
+        class Worker {
+        public:
+            //! Pushes task at bottom.
+
+            //! @param task Task to push.
+            //! @return False if deque is full.
+            bool push(Task *task) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_bottom == capacity) {
+                    if (!m_top) return false;
+                    std::move(m_tasks + m_top, m_tasks + m_bottom, m_tasks);
+                    m_bottom -= m_top;
+                    m_top = 0;
+                }
+                m_tasks[m_bottom++] = task;
+                return true;
+            }
+
+            //! Pops task from bottom, if it was not stolen.
+
+            //! @param task Task pushed last by owner.
+            //! @return True if task was popped.
+            bool pop(Task *task) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_bottom == m_top || m_tasks[m_bottom - 1] != task) return false;
+                --m_bottom;
+                return true;
+            }
+
+            //! Steals oldest task from top.
+
+            //! @return Stolen task, nullptr if deque is empty.
+            Task *steal() {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_bottom == m_top) return nullptr;
+                Task *res = m_tasks[m_top++];
+                if (m_top == m_bottom) m_top = m_bottom = 0;
+                return res;
+            }
+
+        private:
+            static constexpr size_t capacity = 256;//!< Maximal number of tasks in deque.
+
+            std::mutex m_mutex;      //!< Guards deque.
+            Task *m_tasks[capacity]{};//!< Tasks, from m_top to m_bottom.
+            size_t m_top{};          //!< Index of oldest task.
+            size_t m_bottom{};       //!< Index past newest task.
+        };
+
+        //! Loop of pool thread, steals tasks while job runs and sleeps otherwise.
+
+        //! @param index Index of worker of thread.
+        void work(size_t index) {
+            s_pool = this;
+            s_worker = &m_workers[index];
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            for (;;) {
+                m_wake.wait(lock, [this] { return m_stop || m_active.load(std::memory_order_acquire); });
+                if (m_stop) return;
+                lock.unlock();
+                while (m_active.load(std::memory_order_acquire))
+                    if (!steal(s_worker)) std::this_thread::yield();
+                lock.lock();
+            }
+        }
+
+        //! Steals one task from other thread and executes it.
+
+        //! @param thief Worker of calling thread.
+        //! @return True if task was executed.
+        bool steal(Worker *thief) {
+            const size_t self = static_cast<size_t>(thief - m_workers.get());
+            for (size_t i = 1; i < m_size; ++i) {
+                if (Task *task = m_workers[(self + i) % m_size].steal()) {
+                    task->execute();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static inline thread_local ThreadPool *s_pool{};//!< Pool whose job is run by current thread.
+        static inline thread_local Worker *s_worker{};  //!< Worker of current thread.
+
+        size_t m_size;                         //!< Number of threads, calling thread of run() included.
+        std::unique_ptr<Worker[]> m_workers;   //!< Deques of tasks, first one belongs to calling thread of run().
+        std::unique_ptr<std::thread[]> m_threads;//!< Threads of pool.
+        std::mutex m_runMutex;                 //!< Allows only one job at a time.
+        std::mutex m_sleepMutex;               //!< Guards sleeping of threads.
+        std::condition_variable m_wake;        //!< Wakes threads when job starts or pool stops.
+        std::atomic<bool> m_active{};          //!< True while job runs.
+        bool m_stop{};                         //!< True when pool is destroyed.
+    };
+
+}// namespace simple
+#endif// THREADPOOL_H
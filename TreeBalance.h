@@ -0,0 +1,375 @@
+/**
+ * @file TreeBalance.h
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief balancing policies used by binary search tree
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#ifndef TREEBALANCE_H
+#define TREEBALANCE_H
+
+#include <cstddef>
+
+namespace simple {
+    //! Unbalanced policy.
+
+    //! Tree keeps shape given by order of insertions, first inserted element is the root.
+    struct Unbalanced {
+        //! Called after new node was linked into tree, does nothing.
+
+        //! @param root Reference to pointer to root of tree.
+        //! @param node Inserted node.
+        //! @return False, heights are not tracked.
+        template<typename NodeT>
+        static bool insertFixup(NodeT *& /*root*/, NodeT * /*node*/) { return false; }
+
+        //! Called after node with at most one child was unlinked from tree, does nothing.
+
+        //! @param root Reference to pointer to root of tree.
+        //! @param child Child which took place of removed node, may be nullptr.
+        //! @param parent Parent of removed node.
+        //! @param removedRed Color of removed node.
+        //! @return False, heights are not tracked.
+        template<typename NodeT>
+        static bool eraseFixup(NodeT *& /*root*/, NodeT * /*child*/, NodeT * /*parent*/, bool /*removedRed*/) { return false; }
+
+        //! Height of subtree passed to join, not tracked by this policy.
+
+        //! @param root Root of subtree, may be nullptr.
+        //! @return Always 0.
+        template<typename NodeT>
+        static size_t blackHeight(const NodeT * /*root*/) { return 0; }
+
+        //! Height of children of node, not tracked by this policy.
+
+        //! @param node Node.
+        //! @param height Height of node.
+        //! @return Always 0.
+        template<typename NodeT>
+        static size_t childHeight(const NodeT * /*node*/, size_t /*height*/) { return 0; }
+
+        //! Height of parent of node, not tracked by this policy.
+
+        //! @param parent Parent.
+        //! @param height Height of its child.
+        //! @return Always 0.
+        template<typename NodeT>
+        static size_t parentHeight(const NodeT * /*parent*/, size_t /*height*/) { return 0; }
+
+        //! Joins two detached subtrees with middle node between them, O(1).
+
+        //! All elements of left are less than mid, which is less than all elements of right.
+        //! @param left Root of left subtree, may be nullptr.
+        //! @param mid Middle node, becomes root.
+        //! @param right Root of right subtree, may be nullptr.
+        //! @param height Set to 0, heights are not tracked.
+        //! @return Root of joined tree.
+        template<typename NodeT>
+        static NodeT *join(NodeT *left, size_t /*leftHeight*/, NodeT *mid, NodeT *right, size_t /*rightHeight*/, size_t &height) {
+            height = 0;
+            mid->m_parent = nullptr;
+            mid->m_leftNode = left;
+            mid->m_rightNode = right;
+            if (left) left->m_parent = mid;
+            if (right) right->m_parent = mid;
+            mid->update();
+            return mid;
+        }
+    };
+
+    //! Red-black policy.
+
+    //! Keeps tree balanced with red-black rules, height of tree never exceeds 2 log(n + 1),
+    //! so insert, remove and search are O(log n) in worst case.
+    struct RedBlack {
+        //! Restores red-black rules after new node was linked into tree.
+
+        //! @param root Reference to pointer to root of tree.
+        //! @param node Inserted node.
+        //! @return True if black height of tree grew by one.
+        template<typename NodeT>
+        static bool insertFixup(NodeT *&root, NodeT *node) {
+            node->m_red = true;
+            while (node->m_parent && node->m_parent->m_red) {
+                NodeT *parent = node->m_parent;
+                // parent is red so it is not root and grandparent exists
+                NodeT *grandparent = parent->m_parent;
+                if (parent == grandparent->m_leftNode) {
+                    NodeT *uncle = grandparent->m_rightNode;
+                    if (uncle && uncle->m_red) {
+                        parent->m_red = false;
+                        uncle->m_red = false;
+                        grandparent->m_red = true;
+                        node = grandparent;
+                    } else {
+                        if (node == parent->m_rightNode) {
+                            node = parent;
+                            rotateLeft(root, node);
+                            parent = node->m_parent;
+                        }
+                        parent->m_red = false;
+                        grandparent->m_red = true;
+                        rotateRight(root, grandparent);
+                    }
+                } else {
+                    NodeT *uncle = grandparent->m_leftNode;
+                    if (uncle && uncle->m_red) {
+                        parent->m_red = false;
+                        uncle->m_red = false;
+                        grandparent->m_red = true;
+                        node = grandparent;
+                    } else {
+                        if (node == parent->m_leftNode) {
+                            node = parent;
+                            rotateRight(root, node);
+                            parent = node->m_parent;
+                        }
+                        parent->m_red = false;
+                        grandparent->m_red = true;
+                        rotateLeft(root, grandparent);
+                    }
+                }
+            }
+            // root turns red only when the whole tree got one black level more
+            const bool grew = root->m_red;
+            root->m_red = false;
+            return grew;
+        }
+
+        //! Restores red-black rules after node with at most one child was unlinked from tree.
+
+        //! @param root Reference to pointer to root of tree.
+        //! @param child Child which took place of removed node, may be nullptr.
+        //! @param parent Parent of removed node.
+        //! @param removedRed Color of removed node.
+        //! @return True if black height of tree shrank by one.
+        template<typename NodeT>
+        static bool eraseFixup(NodeT *&root, NodeT *child, NodeT *parent, bool removedRed) {
+            if (removedRed) return false;
+            // missing black reaches root only if no rotation or red node absorbed it
+            bool shrank = true;
+            while (child != root && !isRed(child)) {
+                // removed node was black so its sibling subtree is not empty
+                if (child == parent->m_leftNode) {
+                    NodeT *sibling = parent->m_rightNode;
+                    if (sibling->m_red) {
+                        sibling->m_red = false;
+                        parent->m_red = true;
+                        rotateLeft(root, parent);
+                        sibling = parent->m_rightNode;
+                    }
+                    if (!isRed(sibling->m_leftNode) && !isRed(sibling->m_rightNode)) {
+                        sibling->m_red = true;
+                        child = parent;
+                        parent = child->m_parent;
+                    } else {
+                        if (!isRed(sibling->m_rightNode)) {
+                            sibling->m_leftNode->m_red = false;
+                            sibling->m_red = true;
+                            rotateRight(root, sibling);
+                            sibling = parent->m_rightNode;
+                        }
+                        sibling->m_red = parent->m_red;
+                        parent->m_red = false;
+                        sibling->m_rightNode->m_red = false;
+                        rotateLeft(root, parent);
+                        child = root;
+                        shrank = false;
+                    }
+                } else {
+                    NodeT *sibling = parent->m_leftNode;
+                    if (sibling->m_red) {
+                        sibling->m_red = false;
+                        parent->m_red = true;
+                        rotateRight(root, parent);
+                        sibling = parent->m_leftNode;
+                    }
+                    if (!isRed(sibling->m_leftNode) && !isRed(sibling->m_rightNode)) {
+                        sibling->m_red = true;
+                        child = parent;
+                        parent = child->m_parent;
+                    } else {
+                        if (!isRed(sibling->m_leftNode)) {
+                            sibling->m_rightNode->m_red = false;
+                            sibling->m_red = true;
+                            rotateLeft(root, sibling);
+                            sibling = parent->m_leftNode;
+                        }
+                        sibling->m_red = parent->m_red;
+                        parent->m_red = false;
+                        sibling->m_leftNode->m_red = false;
+                        rotateRight(root, parent);
+                        child = root;
+                        shrank = false;
+                    }
+                }
+            }
+            if (isRed(child)) shrank = false;
+            if (child) child->m_red = false;
+            return shrank;
+        }
+
+        //! Black height of subtree, number of black nodes on path from root to leaf.
+
+        //! Walks left spine, O(log n). Computed once per tree, joins get heights from callers.
+        //! @param root Root of subtree, may be nullptr.
+        //! @return Black height, 0 for empty subtree.
+        template<typename NodeT>
+        static size_t blackHeight(const NodeT *root) {
+            size_t res{};
+            for (; root; root = root->m_leftNode)
+                if (!root->m_red) ++res;
+            return res;
+        }
+
+        //! Black height of children of node.
+
+        //! Both children have the same black height, red child keeps it when it is detached and turned black.
+        //! @param node Node.
+        //! @param height Black height of node.
+        //! @return Black height of its children.
+        template<typename NodeT>
+        static size_t childHeight(const NodeT *node, size_t height) { return height - !node->m_red; }
+
+        //! Black height of parent of node.
+
+        //! @param parent Parent.
+        //! @param height Black height of its child.
+        //! @return Black height of parent.
+        template<typename NodeT>
+        static size_t parentHeight(const NodeT *parent, size_t height) { return height + !parent->m_red; }
+
+        //! Joins two detached subtrees with middle node between them.
+
+        //! All elements of left are less than mid, which is less than all elements of right.
+        //! Middle node is linked into spine of taller tree at node with the same black height as
+        //! the other tree, then red-black rules are restored. Black heights are given by caller,
+        //! so join takes O(|black height difference| + 1).
+        //! @param left Root of left subtree, may be nullptr.
+        //! @param leftHeight Black height of left with its root black.
+        //! @param mid Middle node.
+        //! @param right Root of right subtree, may be nullptr.
+        //! @param rightHeight Black height of right with its root black.
+        //! @param height Set to black height of joined tree.
+        //! @return Root of joined tree.
+        template<typename NodeT>
+        static NodeT *join(NodeT *left, size_t leftHeight, NodeT *mid, NodeT *right, size_t rightHeight, size_t &height) {
+            if (left) left->m_red = false;
+            if (right) right->m_red = false;
+            if (leftHeight == rightHeight) {
+                mid->m_parent = nullptr;
+                link(mid, left, right);
+                mid->m_red = false;
+                height = leftHeight + 1;
+                return mid;
+            }
+
+            height = leftHeight > rightHeight ? leftHeight : rightHeight;
+            NodeT *root;
+            NodeT *parent = nullptr;
+            if (leftHeight > rightHeight) {
+                // go down right spine of left tree to black node with black height of right tree
+                root = left;
+                NodeT *curr = left;
+                while (curr && (curr->m_red || leftHeight > rightHeight)) {
+                    if (!curr->m_red) --leftHeight;
+                    parent = curr;
+                    curr = curr->m_rightNode;
+                }
+                link(mid, curr, right);
+                parent->m_rightNode = mid;
+            } else {
+                // go down left spine of right tree to black node with black height of left tree
+                root = right;
+                NodeT *curr = right;
+                while (curr && (curr->m_red || rightHeight > leftHeight)) {
+                    if (!curr->m_red) --rightHeight;
+                    parent = curr;
+                    curr = curr->m_leftNode;
+                }
+                link(mid, left, curr);
+                parent->m_leftNode = mid;
+            }
+            mid->m_parent = parent;
+            for (NodeT *tmp = parent; tmp; tmp = tmp->m_parent) tmp->update();
+            if (insertFixup(root, mid)) ++height;
+            return root;
+        }
+
+    private:
+        //! Sets children of node.
+
+        //! @param node Node.
+        //! @param left New left child, may be nullptr.
+        //! @param right New right child, may be nullptr.
+        template<typename NodeT>
+        static void link(NodeT *node, NodeT *left, NodeT *right) {
+            node->m_leftNode = left;
+            node->m_rightNode = right;
+            if (left) left->m_parent = node;
+            if (right) right->m_parent = node;
+            node->update();
+        }
+
+        //! Checks color of node, empty subtrees are black.
+
+        //! @param node Node to check, may be nullptr.
+        //! @return True if node is red.
+        template<typename NodeT>
+        static bool isRed(const NodeT *node) { return node && node->m_red; }
+
+        //! Left rotation around node, its right child takes its place.
+
+        //! @param root Reference to pointer to root of tree.
+        //! @param node Node to rotate around.
+        template<typename NodeT>
+        static void rotateLeft(NodeT *&root, NodeT *node) {
+            NodeT *pivot = node->m_rightNode;
+            node->m_rightNode = pivot->m_leftNode;
+            if (pivot->m_leftNode) pivot->m_leftNode->m_parent = node;
+            replaceChild(root, node, pivot);
+            pivot->m_leftNode = node;
+            node->m_parent = pivot;
+            node->update();
+            pivot->update();
+        }
+
+        //! Right rotation around node, its left child takes its place.
+
+        //! @param root Reference to pointer to root of tree.
+        //! @param node Node to rotate around.
+        template<typename NodeT>
+        static void rotateRight(NodeT *&root, NodeT *node) {
+            NodeT *pivot = node->m_leftNode;
+            node->m_leftNode = pivot->m_rightNode;
+            if (pivot->m_rightNode) pivot->m_rightNode->m_parent = node;
+            replaceChild(root, node, pivot);
+            pivot->m_rightNode = node;
+            node->m_parent = pivot;
+            node->update();
+            pivot->update();
+        }
+
+        //! Puts other node in place of node in its parent.
+
+        //! @param root Reference to pointer to root of tree.
+        //! @param node Node to replace.
+        //! @param other Node which takes its place.
+        template<typename NodeT>
+        static void replaceChild(NodeT *&root, NodeT *node, NodeT *other) {
+            NodeT *parent = node->m_parent;
+            other->m_parent = parent;
+            if (!parent)
+                root = other;
+            else if (node == parent->m_leftNode)
+                parent->m_leftNode = other;
+            else
+                parent->m_rightNode = other;
+        }
+    };
+
+}// namespace simple
+#endif// TREEBALANCE_H
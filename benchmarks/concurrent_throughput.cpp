@@ -0,0 +1,115 @@
+/**
+ * @file concurrent_throughput.cpp
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief Benchmark of concurrent and sharded binary search tree against binary search tree guarded by one mutex.
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "ConcurrentBST.h"
+#include "ShardedBST.h"
+
+//! Binary search tree guarded by one mutex.
+class LockedTree {
+public:
+    //! Inserts key, returns true if it was inserted.
+    bool insert(int key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t before = m_tree.size();
+        m_tree.insert(key);
+        return m_tree.size() != before;
+    }
+
+    //! Removes key, returns true if it was removed.
+    bool remove(int key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t before = m_tree.size();
+        m_tree.remove(key);
+        return m_tree.size() != before;
+    }
+
+    //! Searches for key.
+    bool search(int key) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_tree.search(key) != nullptr;
+    }
+
+private:
+    mutable std::mutex m_mutex;          //!< Guards whole tree.
+    simple::BinarySearchTree<int> m_tree;//!< Tree.
+};
+
+//! Runs mixed workload on given number of threads.
+
+//! Tree starts with random keys, every thread inserts, removes and searches random keys.
+//! @param threads Number of threads.
+//! @param keys Range of keys.
+//! @param writePercent Percent of operations which insert or remove.
+//! @param duration Time of measurement.
+//! @return Millions of operations per second.
+template<typename Tree>
+double run(size_t threads, int keys, unsigned writePercent, std::chrono::milliseconds duration) {
+    Tree tree;
+    std::mt19937 gen(1);
+    for (int i = 0; i < keys / 2; ++i) tree.insert(static_cast<int>(gen() % keys));
+
+    std::atomic<bool> start{false}, stop{false};
+    std::atomic<size_t> total{0}, hits{0};
+    std::unique_ptr<std::thread[]> workers(new std::thread[threads]);
+    for (size_t t = 0; t < threads; ++t) {
+        workers[t] = std::thread([&, t] {
+            std::mt19937 rnd(static_cast<unsigned>(t) + 7);
+            size_t ops{}, found{};
+            while (!start.load()) std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 64; ++i, ++ops) {
+                    int key = static_cast<int>(rnd() % keys);
+                    unsigned dice = rnd() % 100;
+                    if (dice < writePercent / 2)
+                        tree.insert(key);
+                    else if (dice < writePercent)
+                        tree.remove(key);
+                    else
+                        found += tree.search(key);
+                }
+            }
+            total += ops;
+            hits += found;
+        });
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (size_t t = 0; t < threads; ++t) workers[t].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return static_cast<double>(total.load()) / seconds / 1e6;
+}
+
+int main(int argc, char **argv) {
+    const int keys = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const std::chrono::milliseconds duration(argc > 2 ? std::atoi(argv[2]) : 500);
+    const size_t maxThreads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+
+    std::printf("%d keys, throughput in Mops/s\n", keys);
+    std::printf("%-8s %-8s %14s %14s %14s\n", "threads", "writes", "mutex", "concurrent", "sharded");
+    for (unsigned writePercent: {0u, 10u, 50u}) {
+        for (size_t threads = 1; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2) {
+            double locked = run<LockedTree>(threads, keys, writePercent, duration);
+            double concurrent = run<simple::ConcurrentBinarySearchTree<int>>(threads, keys, writePercent, duration);
+            double sharded = run<simple::ShardedBinarySearchTree<int>>(threads, keys, writePercent, duration);
+            std::printf("%-8zu %6u%% %14.2f %14.2f %14.2f\n", threads, writePercent, locked, concurrent, sharded);
+        }
+    }
+}
@@ -0,0 +1,122 @@
+/**
+ * @file durable_log.cpp
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief Benchmark of durable tree write-ahead log against rewriting whole tree by serialize after every batch.
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "DurableBST.h"
+
+using clock_type = std::chrono::steady_clock;
+
+//! Seconds since start.
+double since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+//! Removes snapshot and log files.
+void removeFiles(const std::string &path) {
+    std::error_code error;
+    for (const char *suffix: {"", ".log", ".log.old", ".tmp"}) std::filesystem::remove(path + suffix, error);
+}
+
+//! Applies random batches to tree and makes every batch durable, prints milliseconds per batch.
+
+//! Log appends only changed elements, serialize rewrites all of them.
+//! @param n Number of elements in tree.
+//! @param batch Number of updates in batch.
+//! @param rounds Number of batches.
+//! @param path Name of snapshot file.
+void runBatches(size_t n, size_t batch, size_t rounds, const std::string &path) {
+    std::mt19937 gen(42);
+    simple::BinarySearchTree<int> plain;
+    {
+        std::unique_ptr<int[]> ints(new int[n]);
+        for (size_t i = 0; i < n; ++i) ints[i] = static_cast<int>(gen());
+        plain.build(ints.get(), ints.get() + n);
+    }
+    removeFiles(path);
+    plain.serialize(path);
+
+    double logTime, rewriteTime;
+    {
+        simple::DurableBinarySearchTree<int> durable(path, batch);
+        std::mt19937 rnd(7);
+        auto start = clock_type::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (size_t i = 0; i < batch; ++i) {
+                const int key = static_cast<int>(rnd());
+                if (rnd() % 2) durable.insert(key);
+                else durable.remove(key);
+            }
+            durable.sync();
+        }
+        logTime = since(start);
+    }
+
+    std::mt19937 rnd(7);
+    auto start = clock_type::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < batch; ++i) {
+            const int key = static_cast<int>(rnd());
+            if (rnd() % 2) plain.insert(key);
+            else plain.remove(key);
+        }
+        plain.serialize(path);
+    }
+    rewriteTime = since(start);
+    removeFiles(path);
+
+    std::printf("%12zu %8zu %14.3f %14.3f\n", n, batch, logTime * 1e3 / static_cast<double>(rounds),
+                rewriteTime * 1e3 / static_cast<double>(rounds));
+}
+
+//! Inserts keys on given number of threads, every insert waits until it is durable.
+
+//! Inserts waiting at the same time share one sync of log.
+//! @param threads Number of threads.
+//! @param perThread Number of inserts of every thread.
+//! @param path Name of snapshot file.
+void runGroupCommit(size_t threads, size_t perThread, const std::string &path) {
+    removeFiles(path);
+    {
+        simple::DurableBinarySearchTree<int> durable(path);
+        std::unique_ptr<std::thread[]> workers(new std::thread[threads]);
+        auto start = clock_type::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers[t] = std::thread([&, t] {
+                for (size_t i = 0; i < perThread; ++i) durable.insert(static_cast<int>(t * perThread + i));
+            });
+        }
+        for (size_t t = 0; t < threads; ++t) workers[t].join();
+        const double seconds = since(start);
+        std::printf("%-8zu %14.0f\n", threads, static_cast<double>(threads * perThread) / seconds);
+    }
+    removeFiles(path);
+}
+
+int main(int argc, char **argv) {
+    const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const size_t batch = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000;
+    const std::string path = argc > 3 ? argv[3] : "bst_durable_bench.bin";
+    const size_t maxThreads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+
+    std::printf("durable batch, ms per batch\n%12s %8s %14s %14s\n", "elements", "batch", "log", "serialize");
+    for (size_t size = n / 100 ? n / 100 : 1; size <= n; size *= 10) runBatches(size, batch, 20, path);
+
+    std::printf("\ngroup commit, durable inserts/s\n%-8s %14s\n", "threads", "inserts/s");
+    for (size_t threads = 1; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2)
+        runGroupCommit(threads, 2000, path);
+}
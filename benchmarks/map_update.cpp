@@ -0,0 +1,67 @@
+/**
+ * @file map_update.cpp
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief Benchmark of value updates in binary search map against tree of pairs updated by search, remove and insert.
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <utility>
+
+#include "MapBST.h"
+
+using clock_type = std::chrono::steady_clock;
+
+//! Seconds since start.
+double since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+//! Compares pairs by first element only.
+struct FirstLess {
+    bool operator()(const std::pair<int, long> &a, const std::pair<int, long> &b) const { return a.first < b.first; }
+};
+
+//! Adds random amounts to values of random keys, prints nanoseconds per update of both ways.
+
+//! Tree of pairs finds old value by search, then removes it and inserts new pair, map adds to value found by operator[].
+//! @param keys Number of distinct keys.
+//! @param updates Number of updates.
+void run(size_t keys, size_t updates) {
+    std::unique_ptr<int[]> order(new int[updates]);
+    std::mt19937 gen(42);
+    for (size_t i = 0; i < updates; ++i) order[i] = static_cast<int>(gen() % keys);
+
+    simple::BinarySearchTree<std::pair<int, long>, FirstLess, simple::RedBlack> pairs;
+    auto start = clock_type::now();
+    for (size_t i = 0; i < updates; ++i) {
+        const std::pair<int, long> probe(order[i], 0);
+        const auto found = pairs.lower_bound(probe);
+        long value = found != pairs.end() && found->first == order[i] ? found->second : 0;
+        pairs.remove(probe);
+        pairs.insert(std::pair<int, long>(order[i], value + static_cast<long>(i)));
+    }
+    const double pairTime = since(start);
+
+    simple::BinarySearchMap<int, long, std::less<int>, simple::RedBlack> map;
+    start = clock_type::now();
+    for (size_t i = 0; i < updates; ++i) map[order[i]] += static_cast<long>(i);
+    const double mapTime = since(start);
+
+    std::printf("%12zu %12zu %14.1f %14.1f%s\n", keys, updates, pairTime * 1e9 / static_cast<double>(updates),
+                mapTime * 1e9 / static_cast<double>(updates), map.size() == pairs.size() ? "" : "  size mismatch!");
+}
+
+int main(int argc, char **argv) {
+    const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::printf("%12s %12s %14s %14s\n", "keys", "updates", "pairs ns", "map ns");
+    for (size_t keys = n / 1000 ? n / 1000 : 1; keys <= n; keys *= 10) run(keys, n);
+}
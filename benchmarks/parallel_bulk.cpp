@@ -0,0 +1,84 @@
+/**
+ * @file parallel_bulk.cpp
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief Benchmark of parallel bulk build, union, intersection and clear on 1 to N threads.
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "BST.h"
+
+using Tree = simple::BinarySearchTree<int, std::less<int>, simple::RedBlack>;
+using clock_type = std::chrono::steady_clock;
+
+//! Times of all measured operations, in milliseconds.
+struct Times {
+    double build{};       //!< Bulk build of both trees.
+    double intersection{};//!< Intersection of both trees.
+    double unite{};       //!< Union of both trees.
+    double clear{};       //!< Clear of result.
+};
+
+//! Milliseconds since start.
+double since(clock_type::time_point start) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+//! Measures all operations on given number of threads.
+Times run(const int *first, const int *second, size_t n, size_t threads) {
+    simple::ThreadPool pool(threads);
+    Times res;
+    Tree a, b, c;
+
+    auto start = clock_type::now();
+    a.build(first, first + n, pool);
+    b.build(second, second + n, pool);
+    res.build = since(start);
+
+    c.build(second, second + n, pool);
+    start = clock_type::now();
+    c.set_intersection(a, pool);
+    res.intersection = since(start);
+
+    start = clock_type::now();
+    a.set_union(b, pool);
+    res.unite = since(start);
+
+    start = clock_type::now();
+    a.clear(pool);
+    res.clear = since(start);
+    return res;
+}
+
+int main(int argc, char **argv) {
+    const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    const size_t maxThreads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+
+    std::unique_ptr<int[]> first(new int[n]), second(new int[n]);
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, static_cast<int>(2 * n));
+    for (size_t i = 0; i < n; ++i) {
+        first[i] = dist(gen);
+        second[i] = dist(gen);
+    }
+
+    std::printf("%zu random elements per tree, times in ms (speedup)\n", n);
+    std::printf("%-8s %18s %18s %18s %18s\n", "threads", "build", "intersection", "union", "clear");
+    Times base{};
+    for (size_t threads = 1; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2) {
+        Times t = run(first.get(), second.get(), n, threads);
+        if (threads == 1) base = t;
+        std::printf("%-8zu %10.1f (%4.2fx) %10.1f (%4.2fx) %10.1f (%4.2fx) %10.1f (%4.2fx)\n", threads,
+                    t.build, base.build / t.build, t.intersection, base.intersection / t.intersection,
+                    t.unite, base.unite / t.unite, t.clear, base.clear / t.clear);
+    }
+}
@@ -0,0 +1,171 @@
+/**
+ * @file serialize_throughput.cpp
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief Benchmark of serialize and deserialize throughput for integers and strings, of text format, of frozen tree files and of background serialize.
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "BST.h"
+#include "PersistentBST.h"
+
+using clock_type = std::chrono::steady_clock;
+
+//! Seconds since start.
+double since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+//! Size of file in bytes.
+double fileSize(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return static_cast<double>(file.tellg());
+}
+
+//! Serializes and deserializes tree, prints throughput in GB/s of file size and millions of elements per second.
+template<typename Tree>
+void run(const char *name, const Tree &source, const std::string &path) {
+    auto start = clock_type::now();
+    source.serialize(path);
+    const double save = since(start);
+    const double bytes = fileSize(path);
+
+    Tree loaded;
+    start = clock_type::now();
+    loaded.deserialize(path);
+    const double load = since(start);
+    std::remove(path.c_str());
+
+    const auto elements = static_cast<double>(source.size());
+    std::printf("%-8s %12zu %10.1f MB %8.2f GB/s %8.2f GB/s %9.1f M/s %9.1f M/s%s\n", name, source.size(), bytes / 1e6,
+                bytes / save / 1e9, bytes / load / 1e9, elements / save / 1e6, elements / load / 1e6,
+                loaded.size() == source.size() ? "" : "  size mismatch!");
+}
+
+//! Writes tree in text format and reads it back by >> operator and by read_text() on all threads, prints millions of elements per second.
+
+//! Elements must not contain whitespace, text format separates them by it.
+template<typename T>
+void runText(const char *name, const simple::BinarySearchTree<T> &source, const std::string &path) {
+    auto start = clock_type::now();
+    {
+        std::ofstream oFile(path);
+        oFile << source;
+    }
+    const double save = since(start);
+    const double bytes = fileSize(path);
+
+    simple::BinarySearchTree<T> loaded, parallel;
+    start = clock_type::now();
+    {
+        std::ifstream iFile(path);
+        iFile >> loaded;
+    }
+    const double load = since(start);
+    simple::ThreadPool pool;
+    start = clock_type::now();
+    {
+        std::ifstream iFile(path);
+        parallel.read_text(iFile, pool);
+    }
+    const double parallelLoad = since(start);
+    std::remove(path.c_str());
+
+    const auto elements = static_cast<double>(source.size());
+    std::printf("%-8s %12zu %10.1f MB %9.1f M/s %9.1f M/s %9.1f M/s%s\n", name, source.size(), bytes / 1e6, elements / save / 1e6,
+                elements / load / 1e6, elements / parallelLoad / 1e6,
+                loaded.size() == source.size() && parallel.size() == source.size() ? "" : "  size mismatch!");
+}
+
+//! Freezes tree, maps file and searches all elements, prints throughput of freeze and time of open.
+template<typename T>
+void runFrozen(const char *name, const simple::BinarySearchTree<T> &source, const std::string &path) {
+    auto start = clock_type::now();
+    source.freeze_to(path);
+    const double freeze = since(start);
+    const double bytes = fileSize(path);
+
+    start = clock_type::now();
+    size_t found{};
+    {
+        simple::FrozenBinarySearchTree<T> frozen(path);
+        const double open = since(start);
+        start = clock_type::now();
+        for (const auto &e: const_cast<simple::BinarySearchTree<T> &>(source)) found += frozen.search(e);
+        const double search = since(start);
+        std::printf("%-8s %12zu %10.1f MB %8.2f GB/s %10.3f ms open, %.0f ns/search%s\n", name, source.size(), bytes / 1e6,
+                    bytes / freeze / 1e9, open * 1e3, search * 1e9 / static_cast<double>(source.size()),
+                    found == source.size() ? "" : "  missing elements!");
+    }
+    std::remove(path.c_str());
+}
+
+//! Writes persistent tree in background while foreground thread keeps updating it.
+
+//! Prints time until serialize_async() returns, time of whole write and number of updates done meanwhile.
+//! @param name Name of row.
+//! @param source Tree to write.
+//! @param path Name of file.
+void runAsync(const char *name, const simple::BinarySearchTree<int> &source, const std::string &path) {
+    simple::PersistentBinarySearchTree<int> tree;
+    for (const auto &e: const_cast<simple::BinarySearchTree<int> &>(source)) tree.insert(e);
+    std::mt19937 gen(3);
+
+    auto start = clock_type::now();
+    auto written = tree.serialize_async(path);
+    const double call = since(start);
+    size_t updates{};
+    while (written.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        const int key = static_cast<int>(gen());
+        if (key & 1) tree.insert(key);
+        else tree.remove(key);
+        ++updates;
+    }
+    const bool ok = written.get();
+    const double write = since(start);
+    std::remove(path.c_str());
+    std::printf("%-8s %12zu %10.3f ms %10.1f ms %12zu%s\n", name, source.size(), call * 1e3, write * 1e3, updates,
+                ok ? "" : "  write failed!");
+}
+
+int main(int argc, char **argv) {
+    const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    const std::string path = argc > 2 ? argv[2] : "bst_serialize_bench.bin";
+
+    std::mt19937 gen(42);
+    std::unique_ptr<int[]> ints(new int[n]);
+    for (size_t i = 0; i < n; ++i) ints[i] = static_cast<int>(gen());
+    simple::BinarySearchTree<int> intTree;
+    intTree.build(ints.get(), ints.get() + n);
+    ints.reset();
+
+    const size_t strings = n / 10;
+    std::unique_ptr<std::string[]> words(new std::string[strings]);
+    for (size_t i = 0; i < strings; ++i) words[i] = "key " + std::to_string(gen()) + " value " + std::to_string(i);
+    simple::BinarySearchTree<std::string> stringTree;
+    stringTree.build(words.get(), words.get() + strings);
+    words.reset();
+
+    std::printf("%-8s %12s %13s %13s %13s %13s %13s\n", "type", "elements", "file", "serialize", "deserialize", "serialize", "deserialize");
+    run("int", intTree, path);
+    run("string", stringTree, path);
+
+    std::printf("\n%-8s %12s %13s %13s %13s %13s\n", "text", "elements", "file", "<<", ">>", "read_text");
+    runText("int", intTree, path);
+
+    std::printf("\n%-8s %12s %13s %13s\n", "frozen", "elements", "file", "freeze_to");
+    runFrozen("int", intTree, path);
+    runFrozen("string", stringTree, path);
+
+    std::printf("\n%-8s %12s %13s %13s %12s\n", "async", "elements", "call", "write", "updates");
+    runAsync("int", intTree, path);
+}
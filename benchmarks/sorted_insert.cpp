@@ -0,0 +1,49 @@
+/**
+ * @file sorted_insert.cpp
+ * @author Michal Smaluch (https://github.com/drago20013)
+ * @brief Benchmark of binary search tree with sorted input, unbalanced and red-black tree.
+ * @version 1.0
+ * @date 2022-01-05
+ *
+ * @copyright GNU Public License v3.0
+ */
+
+#include <chrono>
+#include <cstdio>
+
+#include "BST.h"
+
+//! Measures inserting n sorted elements and searching for all of them.
+template<typename Tree>
+void run(const char *name, int n) {
+    using clock = std::chrono::steady_clock;
+    Tree tree;
+
+    auto start = clock::now();
+    for (int i = 0; i < n; ++i) tree.insert(i);
+    auto inserted = clock::now();
+
+    size_t found{};
+    for (int i = 0; i < n; ++i) found += tree.search(i) != nullptr;
+    auto searched = clock::now();
+
+    tree.clear();
+    auto cleared = clock::now();
+
+    auto perOp = [n](clock::duration d) {
+        return std::chrono::duration<double, std::nano>(d).count() / n;
+    };
+    std::printf("%-12s %10d %14.1f %14.1f %14.1f %s\n", name, n,
+                perOp(inserted - start), perOp(searched - inserted), perOp(cleared - searched),
+                found == static_cast<size_t>(n) ? "" : "(search failed)");
+}
+
+int main() {
+    std::printf("%-12s %10s %14s %14s %14s\n", "balance", "elements", "insert ns/op", "search ns/op", "clear ns/op");
+    for (int n: {1000, 4000, 16000, 32000}) {
+        run<simple::BinarySearchTree<int>>("unbalanced", n);
+        run<simple::BinarySearchTree<int, std::less<int>, simple::RedBlack>>("red-black", n);
+    }
+    for (int n: {1000000, 4000000})
+        run<simple::BinarySearchTree<int, std::less<int>, simple::RedBlack>>("red-black", n);
+}
@@ -8,13 +8,30 @@
  * @copyright GNU Public License v3.0
  */
 
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+
+typedef std::pair<int *, std::string> myPair;
+
+std::ostream &operator<<(std::ostream &os, const myPair &src);
+std::istream &operator>>(std::istream &is, myPair &src);
 
 #include "BST.h"
+#include "ConcurrentBST.h"
+#include "DurableBST.h"
+#include "MapBST.h"
 
-typedef std::pair<int *, std::string> myPair;
+//! Binary search tree with comparison criteria chosen at runtime.
+template<typename T>
+using FunctionTree = simple::BinarySearchTree<T, std::function<bool(const T &a, const T &b)>>;
 
 //! Helper struct used for testing
 struct Vector3 {
@@ -84,8 +101,8 @@ struct Vector3 {
 
 //! Template function used for printing tree.
 //! It uses forward iterator and print data in order.
-template<typename T>
-void printTree(simple::BinarySearchTree<T> &tree) {
+template<typename T, typename Compare>
+void printTree(simple::BinarySearchTree<T, Compare> &tree) {
     std::cout << "number of elements: " << tree.size() << "\n";
     for (auto &e: tree)
         std::cout << e << " ";
@@ -95,8 +112,8 @@ void printTree(simple::BinarySearchTree<T> &tree) {
 
 //! Template function used for printing tree.
 //! It uses reverse iterator and print data in reverse order.
-template<typename T>
-void reversePrint(simple::BinarySearchTree<T> &tree) {
+template<typename T, typename Compare>
+void reversePrint(simple::BinarySearchTree<T, Compare> &tree) {
     std::cout << "number of elements: " << tree.size() << "\n";
     for (auto rIt = tree.rbegin(); rIt != tree.rend(); rIt++)
         std::cout << *rIt << " ";
@@ -104,9 +121,9 @@ void reversePrint(simple::BinarySearchTree<T> &tree) {
     std::cout << "\n-------------------------------------" << std::endl;
 }
 
-//! Specialized template for Vector3.
-template<>
-void printTree(simple::BinarySearchTree<Vector3> &tree) {
+//! Overloaded template for Vector3.
+template<typename Compare>
+void printTree(simple::BinarySearchTree<Vector3, Compare> &tree) {
     std::cout << "number of elements: " << tree.size() << "\n";
     for (auto &e: tree)
         std::cout << e << "\n";
@@ -114,10 +131,10 @@ void printTree(simple::BinarySearchTree<Vector3> &tree) {
     std::cout << "-------------------------------------" << std::endl;
 }
 
-//! Specialized template for Vector3.
+//! Overloaded template for Vector3.
 //! It uses reverse iterator and print data in reverse order.
-template<>
-void reversePrint(simple::BinarySearchTree<Vector3> &tree) {
+template<typename Compare>
+void reversePrint(simple::BinarySearchTree<Vector3, Compare> &tree) {
     std::cout << "number of elements: " << tree.size() << "\n";
     for (auto rIt = tree.rbegin(); rIt != tree.rend(); rIt++)
         std::cout << *rIt << "\n";
@@ -125,9 +142,9 @@ void reversePrint(simple::BinarySearchTree<Vector3> &tree) {
     std::cout << "-------------------------------------" << std::endl;
 }
 
-//! Specialized template for std::pair<int*, std::string>
-template<>
-void printTree(simple::BinarySearchTree<myPair> &tree) {
+//! Overloaded template for std::pair<int*, std::string>
+template<typename Compare>
+void printTree(simple::BinarySearchTree<myPair, Compare> &tree) {
     std::cout << "number of elements: " << tree.size() << "\n";
     for (auto &[x, y]: tree)
         std::cout << *x << " " << y << " \n";
@@ -135,10 +152,10 @@ void printTree(simple::BinarySearchTree<myPair> &tree) {
     std::cout << "-------------------------------------" << std::endl;
 }
 
-//! Specialized template for std::pair<int*, std::string>
+//! Overloaded template for std::pair<int*, std::string>
 //! It uses reverse iterator and print data in reverse order.
-template<>
-void reversePrint(simple::BinarySearchTree<myPair> &tree) {
+template<typename Compare>
+void reversePrint(simple::BinarySearchTree<myPair, Compare> &tree) {
     std::cout << "number of elements: " << tree.size() << "\n";
     for (auto rIt = tree.rbegin(); rIt != tree.rend(); rIt++)
         std::cout << *rIt->first << " " << rIt->second << " \n";
@@ -167,9 +184,9 @@ void testTree(
         const T &toRemove_3 = {},
         std::function<bool(const T &a, const T &b)> compFunc = [](const T &a, const T &b) { return a < b; }) {
 
-    simple::BinarySearchTree<T> testTree1(compFunc);
-    simple::BinarySearchTree<T> testTree2(compFunc);
-    simple::BinarySearchTree<T> testTree3(init, compFunc);
+    FunctionTree<T> testTree1(compFunc);
+    FunctionTree<T> testTree2(compFunc);
+    FunctionTree<T> testTree3(init, compFunc);
 
     //emplace
     for (auto &e: init) testTree2.emplace(e);
@@ -219,6 +236,195 @@ void testTree(
     }
 }
 
+//! Copy assigns slab allocated tree onto another non-empty one and checks content of target.
+void testSlabCopy() {
+    typedef simple::BinarySearchTree<int, std::less<int>, simple::RedBlack, simple::SlabNodeAllocator> SlabTree;
+    SlabTree source, target;
+    for (int i = 0; i < 1000; ++i) source.insert(i * 3);
+    for (int i = 0; i < 500; ++i) target.insert(i * 7);
+
+    target = source;
+    source.clear();
+
+    bool ok = target.size() == 1000;
+    int expected{};
+    for (const auto &e: target) {
+        ok = ok && e == expected;
+        expected += 3;
+    }
+    std::cout << "copy assignment of slab tree: " << (ok && expected == 3000 ? "ok" : "failed") << std::endl;
+}
+
+//! Clears slab trees and builds them again from the same elements.
+
+//! Freed nodes stay in arena when it is shared or elements have destructors, rebuild has to reuse them.
+void testSlabRebuild() {
+    typedef simple::BinarySearchTree<std::string, std::less<std::string>, simple::RedBlack, simple::SlabNodeAllocator> StringTree;
+    typedef simple::BinarySearchTree<int, std::less<int>, simple::RedBlack, simple::SlabNodeAllocator> SlabTree;
+    std::string words[1000];
+    int keys[1000];
+    for (int i = 0; i < 1000; ++i) {
+        words[i] = std::to_string(100000 + i);
+        keys[i] = i;
+    }
+
+    StringTree strings;
+    strings.assign_sorted(words, words + 1000);
+    const size_t stringCapacity = strings.get_allocator().capacity();
+    strings.clear();
+    strings.assign_sorted(words, words + 1000);
+
+    SlabTree shared;
+    shared.assign_sorted(keys, keys + 1000);
+    auto allocator = shared.get_allocator();
+    const size_t sharedCapacity = allocator.capacity();
+    shared.clear();
+    shared.assign_sorted(keys, keys + 1000);
+
+    const bool ok = strings.size() == 1000 && shared.size() == 1000 && strings.get_allocator().capacity() == stringCapacity &&
+                    allocator.capacity() == sharedCapacity;
+    std::cout << "rebuild of cleared slab tree reuses memory: " << (ok ? "ok" : "failed") << std::endl;
+}
+
+//! Removes and inserts odd keys on two threads while two other threads search and iterate even keys.
+
+//! Even keys stay in tree all the time, but removes of odd keys splice them up, readers must never miss them.
+void testConcurrentReads() {
+    const int keys = 1 << 12;
+    simple::ConcurrentBinarySearchTree<int> tree;
+    int order[keys];
+    for (int i = 0; i < keys; ++i) order[i] = i;
+    std::shuffle(order, order + keys, std::mt19937(5));
+    for (int key: order) tree.insert(key);
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> misses{};
+    auto writer = [&](unsigned seed) {
+        std::mt19937 gen(seed);
+        while (!stop.load(std::memory_order_relaxed)) {
+            const int key = static_cast<int>(gen() % (keys / 2)) * 2 + 1;
+            tree.remove(key);
+            tree.insert(key);
+        }
+    };
+    auto reader = [&] {
+        for (int round = 0; round < 100; ++round) {
+            for (int key = 0; key < keys; key += 2)
+                if (!tree.search(key)) ++misses;
+            int expected{};
+            for (int key: tree) {
+                if (key % 2) continue;
+                if (key != expected) ++misses;
+                expected = key + 2;
+            }
+            if (expected != keys) ++misses;
+        }
+    };
+
+    std::thread writers[2] = {std::thread(writer, 1), std::thread(writer, 2)};
+    std::thread readers[2] = {std::thread(reader), std::thread(reader)};
+    for (auto &t: readers) t.join();
+    stop = true;
+    for (auto &t: writers) t.join();
+    std::cout << "concurrent search during removes: " << (misses == 0 && tree.size() == keys ? "ok" : "failed") << std::endl;
+}
+
+//! Checks that durable tree holds the same elements as expected tree.
+bool sameElements(const simple::DurableBinarySearchTree<int> &tree, const simple::BinarySearchTree<int> &expected) {
+    auto it = expected.begin();
+    bool same = tree.size() == expected.size();
+    tree.for_each([&](const int &e) {
+        same = same && it != expected.end() && *it == e;
+        if (it != expected.end()) ++it;
+    });
+    return same;
+}
+
+//! Writes updates to durable tree, then recovers it from log, from log with torn tail and from compacted snapshot.
+void testDurable() {
+    const std::string path = "durable.bin";
+    auto removeFiles = [&] {
+        std::error_code error;
+        for (const char *suffix: {"", ".log", ".log.old", ".tmp"}) std::filesystem::remove(path + suffix, error);
+    };
+    removeFiles();
+
+    simple::BinarySearchTree<int> expected;
+    bool ok;
+    {
+        simple::DurableBinarySearchTree<int> tree(path);
+        ok = tree.is_open();
+        for (int i = 0; i < 1000; ++i) {
+            ok = tree.insert(i) && ok;
+            expected.insert(i);
+        }
+        for (int i = 0; i < 1000; i += 3) {
+            ok = tree.remove(i) && ok;
+            expected.remove(i);
+        }
+    }
+    {
+        // recovery from log
+        simple::DurableBinarySearchTree<int> tree(path);
+        ok = ok && sameElements(tree, expected);
+        tree.insert(5000);
+    }
+    {
+        // last batch is torn, it is cut off
+        const auto size = std::filesystem::file_size(path + ".log");
+        std::filesystem::resize_file(path + ".log", size - 3);
+        simple::DurableBinarySearchTree<int> tree(path);
+        ok = ok && sameElements(tree, expected) && std::filesystem::file_size(path + ".log") < size - 3;
+
+        const size_t logSize = tree.log_size();
+        tree.compact();
+        tree.wait_compaction();
+        ok = ok && tree.log_size() < logSize && !std::filesystem::exists(path + ".log.old");
+    }
+    {
+        // recovery from compacted snapshot
+        simple::DurableBinarySearchTree<int> tree(path);
+        ok = ok && sameElements(tree, expected);
+    }
+    removeFiles();
+    std::cout << "durable tree recovery: " << (ok ? "ok" : "failed") << std::endl;
+}
+
+//! Helper struct counting its constructions, used for testing of map.
+struct Counted {
+    static inline int constructed{};//!< Number of constructed objects.
+    int value{};                    //!< Value.
+
+    Counted() { ++constructed; }
+    explicit Counted(int v) : value(v) { ++constructed; }
+    Counted(const Counted &other) : value(other.value) { ++constructed; }
+    Counted &operator=(const Counted &other) = default;
+};
+
+//! Tests single descent operations of map, existing keys must not construct anything.
+void testMap() {
+    simple::BinarySearchMap<std::string, Counted> map;
+    const std::string one{"one"}, two{"two"}, three{"three"};
+    bool ok = map.try_emplace(one, 1).second;
+
+    const int constructed = Counted::constructed;
+    const auto [value, inserted] = map.try_emplace(one, 2);
+    ok = ok && !inserted && value->value == 1;
+    ok = ok && map[one].value == 1 && Counted::constructed == constructed;
+
+    ok = ok && !map.insert_or_assign(one, Counted(3)).second && map.find(one)->value == 3;
+    ok = ok && map[two].value == 0 && map.size() == 2;
+
+    map.find(two)->value = 7;
+    ok = ok && map.find(two)->value == 7;
+
+    map.remove(three);
+    ok = ok && map.size() == 2 && !map.find(three);
+    map.remove(two);
+    ok = ok && map.size() == 1 && !map.contains(two) && map.contains(one);
+    std::cout << "map try_emplace, insert_or_assign, operator[], find and remove: " << (ok ? "ok" : "failed") << std::endl;
+}
+
 int main() {
     int nrOfTest{1};
     // Testing BST with ints
@@ -262,7 +468,7 @@ int main() {
     iTree.serialize("data.bin");
 
     //changing comparison criteria
-    simple::BinarySearchTree<int> iTree2([](const int &a, const int &b) { return a > b; });
+    simple::BinarySearchTree<int, std::greater<int>> iTree2;
 
     simple::BinarySearchTree<Vector3> asd;
 
@@ -285,4 +491,19 @@ int main() {
     strTree.deserialize("stringTree.bin");
 
     printTree(strTree);
+
+    // Testing copy assignment of trees with slab allocator
+    testSlabCopy();
+
+    // Testing reuse of slab memory after clear
+    testSlabRebuild();
+
+    // Testing lock-free reads of concurrent tree while other threads remove elements
+    testConcurrentReads();
+
+    // Testing recovery of durable tree from write-ahead log
+    testDurable();
+
+    // Testing key - value map
+    testMap();
 }